@@ -0,0 +1,94 @@
+#include <cmath>
+#include <iterator>
+#include <algorithm>
+
+#include "draw_order.hpp"
+
+namespace UI {
+
+namespace {
+
+// 0 .. split - 1 ascending, then count - 1 .. split descending: farthest
+// from the eye first on both sides
+template <typename Fn>
+void VisitTowardsEye(int32_t count, int32_t split, Fn&& fn)
+{
+    for (int32_t i = 0; i < split; i++) {
+        fn(i);
+    }
+    for (int32_t i = count - 1; i >= split; i--) {
+        fn(i);
+    }
+}
+
+}
+
+bool BackToFrontOrder::Update(const VoxelBuffer& voxels, const std::array<float, 3>& eye)
+{
+    // voxel i spans i - 0.5 .. i + 0.5, the one containing the eye goes last
+    std::array<int32_t, 3> new_split;
+    for (int axis = 0; axis < 3; axis++) {
+        auto slab = static_cast<int32_t>(std::floor(eye[axis] + 0.5f));
+        new_split[axis] = std::clamp(slab, 0, voxels.size[axis]);
+    }
+    if (this->valid && voxels.version == this->version && voxels.size.elements == this->size.elements &&
+        new_split == this->split) {
+        return false;
+    }
+    this->valid = true;
+    this->version = voxels.version;
+    this->size = voxels.size;
+    this->split = new_split;
+
+    auto [rows, cols, stacks] = voxels.size.elements;
+    const auto& visible = voxels.visible;
+    size_t lines = static_cast<size_t>(rows) * stacks;
+    this->row_offsets.assign(lines + 1, 0);
+    bool sorted = true;
+    uint32_t previous = 0;
+    for (auto index : visible) {
+        this->row_offsets[index / cols + 1]++;
+        sorted = sorted && index >= previous;
+        previous = index;
+    }
+    for (size_t line = 0; line < lines; line++) {
+        this->row_offsets[line + 1] += this->row_offsets[line];
+    }
+
+    // colouring in index order is the common case, anything else
+    // (e.g. plane by plane) gets bucketed by row first
+    const uint32_t* source = visible.data();
+    if (!sorted) {
+        this->bucketed.resize(visible.size());
+        this->row_fill.assign(this->row_offsets.begin(), this->row_offsets.end() - 1);
+        for (auto index : visible) {
+            this->bucketed[this->row_fill[index / cols]++] = index;
+        }
+        for (size_t line = 0; line < lines; line++) {
+            std::sort(this->bucketed.begin() + this->row_offsets[line],
+                      this->bucketed.begin() + this->row_offsets[line + 1]);
+        }
+        source = this->bucketed.data();
+    }
+
+    this->indices.clear();
+    this->indices.reserve(visible.size());
+    VisitTowardsEye(stacks, this->split[2], [&](int32_t stack) {
+        VisitTowardsEye(rows, this->split[0], [&](int32_t row) {
+            size_t line = static_cast<size_t>(stack) * rows + row;
+            const uint32_t* begin = source + this->row_offsets[line];
+            const uint32_t* end = source + this->row_offsets[line + 1];
+            if (begin == end) {
+                return;
+            }
+            auto past_eye = static_cast<uint32_t>(line * cols + this->split[1]);
+            const uint32_t* middle = std::lower_bound(begin, end, past_eye);
+            this->indices.insert(this->indices.end(), begin, middle);
+            this->indices.insert(this->indices.end(), std::make_reverse_iterator(end),
+                                 std::make_reverse_iterator(middle));
+        });
+    });
+    return true;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "voxel.hpp"
+
+namespace UI
+{
+
+/**
+ * Back to front order of the visible voxels, for blending, without sorting.
+ *
+ * On a regular grid a correct order follows from the position of the eye
+ * alone: along every axis the voxels on either side of the eye are visited
+ * from the far end towards the eye, stacks outermost, then rows, then
+ * columns. Voxels on opposite sides of an axis plane through the eye never
+ * overlap on screen, so the two sides can simply follow each other.
+ *
+ * VoxelBuffer::visible is usually sorted by index (SetColor in index order,
+ * Colormap also for the strided FDTD fields), which makes this a linear
+ * pass: the rows of the grid are contiguous runs of it, visited in slab
+ * order, each split at the eye's column. Anything else (the planes of the
+ * slice view) gets bucketed by row and the rows sorted first. The order is
+ * only rebuilt when the voxels changed or the eye moved into another slab.
+ */
+class BackToFrontOrder
+{
+public:
+    // eye in voxel coordinates, returns true when the order changed
+    bool Update(const VoxelBuffer& voxels, const std::array<float, 3>& eye);
+
+    // Voxel indices, farthest first
+    const std::vector<uint32_t>& Indices() const { return this->indices; }
+
+private:
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> row_offsets; // start of every row (stack * rows + row) in visible
+    std::vector<uint32_t> bucketed;    // visible grouped by row, when it isn't sorted
+    std::vector<uint32_t> row_fill;
+    std::array<int32_t, 3> split{-1, -1, -1}; // first voxel past the eye along each axis
+    utils::Vec<int32_t, 3> size{0, 0, 0};
+    uint64_t version = 0; // VoxelBuffer::version of the order
+    bool valid = false;
+};
+
+}
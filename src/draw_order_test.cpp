@@ -0,0 +1,87 @@
+#include <cmath>
+#include <random>
+#include <cassert>
+#include <algorithm>
+
+#include "draw_order.hpp"
+#include "log.hpp"
+
+using namespace UI;
+
+const auto red = utils::Color{255, 0, 0, 128};
+const auto transparent = utils::Color{0, 0, 0, 0};
+
+// Voxels farther from the eye along every axis (and on the same side of it)
+// are behind and have to come first
+void check_order(const VoxelBuffer& voxels, const std::vector<uint32_t>& order, const std::array<float, 3>& eye)
+{
+    auto sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    auto visible = voxels.visible;
+    std::sort(visible.begin(), visible.end());
+    assert(sorted == visible);
+
+    for (size_t a = 0; a < order.size(); a++) {
+        auto pa = voxels.Position(order[a]);
+        for (size_t b = a + 1; b < order.size(); b++) {
+            auto pb = voxels.Position(order[b]);
+            bool behind = true, strictly = false;
+            for (int axis = 0; axis < 3; axis++) {
+                float da = static_cast<float>(pa[axis]) - eye[axis];
+                float db = static_cast<float>(pb[axis]) - eye[axis];
+                // straddling the eye's plane, or on the other side of it
+                if (std::abs(da) < 0.5f || std::abs(db) < 0.5f || (da < 0) != (db < 0)) {
+                    behind = false;
+                    break;
+                }
+                behind = behind && std::abs(db) >= std::abs(da);
+                strictly = strictly || std::abs(db) > std::abs(da);
+            }
+            // b is drawn after a, so it must not be behind it
+            assert(!(behind && strictly));
+        }
+    }
+}
+
+int main(void)
+{
+    VoxelBuffer voxels;
+    voxels.Resize({12, 10, 8});
+    std::mt19937 rng(42);
+    std::bernoulli_distribution alive(0.2);
+    voxels.BeginFrame();
+    for (uint32_t i = 0; i < voxels.Count(); i++) {
+        voxels.SetColor(i, alive(rng) ? red : transparent);
+    }
+    Log::debug("visible voxels: ", voxels.visible.size());
+
+    // outside the grid, on its corners and faces, and inside
+    const std::array<float, 3> eyes[] = {
+        {-20.0f, -20.0f, -20.0f},
+        {30.0f, 25.0f, 20.0f},
+        {5.25f, -15.0f, 3.75f},
+        {6.3f, 4.6f, 3.2f},
+        {11.0f, 9.0f, 40.0f},
+    };
+    BackToFrontOrder order;
+    for (const auto& eye : eyes) {
+        assert(order.Update(voxels, eye));
+        check_order(voxels, order.Indices(), eye);
+    }
+
+    // nothing changed, or the eye stayed in the same slab
+    assert(!order.Update(voxels, {11.0f, 9.0f, 40.0f}));
+    assert(!order.Update(voxels, {11.2f, 8.9f, 45.0f}));
+    assert(order.Update(voxels, {11.6f, 8.9f, 45.0f}));
+
+    // visible not in index order (e.g. coloured plane by plane) gives the same order
+    auto expected = order.Indices();
+    voxels.BeginFrame();
+    for (uint32_t i = static_cast<uint32_t>(voxels.Count()); i-- > 0; ) {
+        voxels.SetColor(i, voxels.colors[i]);
+    }
+    assert(order.Update(voxels, {11.6f, 8.9f, 45.0f}));
+    assert(order.Indices() == expected);
+
+    return 0;
+}
@@ -0,0 +1,392 @@
+#include <array>
+#include <csignal>
+#include <fstream>
+#include <stdexcept>
+
+#include "log.hpp"
+#include "frame_writer.hpp"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace UI {
+
+namespace {
+
+constexpr uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+// deflate lengths 3..258, RFC 1951 3.2.5
+constexpr uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+constexpr uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    static const auto table = []() {
+        std::array<uint32_t, 256> table;
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t Adler32(const uint8_t* data, size_t size)
+{
+    constexpr uint32_t MOD = 65521;
+    constexpr size_t NMAX = 5552; // largest n for which the sums don't overflow
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        size_t n = std::min(size, NMAX);
+        size -= n;
+        while (n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= MOD;
+        b %= MOD;
+    }
+    return (b << 16) | a;
+}
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    // least significant bit first (header fields, extra bits)
+    void Put(uint32_t value, int count)
+    {
+        this->bits |= value << this->count;
+        this->count += count;
+        while (this->count >= 8) {
+            this->out.push_back(static_cast<uint8_t>(this->bits));
+            this->bits >>= 8;
+            this->count -= 8;
+        }
+    }
+
+    // Huffman codes go most significant bit first
+    void PutCode(uint32_t code, int count)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < count; i++) {
+            reversed |= ((code >> i) & 1) << (count - 1 - i);
+        }
+        Put(reversed, count);
+    }
+
+    void Flush()
+    {
+        if (this->count > 0) {
+            this->out.push_back(static_cast<uint8_t>(this->bits));
+        }
+        this->bits = 0;
+        this->count = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint32_t bits = 0;
+    int count = 0;
+};
+
+// fixed Huffman codes, RFC 1951 3.2.6
+void PutSymbol(BitWriter& writer, uint32_t symbol)
+{
+    if (symbol < 144) {
+        writer.PutCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.PutCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.PutCode(symbol - 256, 7);
+    } else {
+        writer.PutCode(0xc0 + symbol - 280, 8);
+    }
+}
+
+/*
+ * zlib stream with a single fixed Huffman block, the only matches are
+ * runs of the previous byte (distance 1). After the Sub filter that's
+ * what a rendered frame mostly consists of (flat background), so this
+ * gets most of the gain of a real deflate at a fraction of the cost.
+ */
+void Deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+{
+    out.push_back(0x78); // deflate, 32K window
+    out.push_back(0x01); // fastest, no dictionary, (0x7801 % 31 == 0)
+    BitWriter writer(out);
+    writer.Put(1, 1); // last block
+    writer.Put(1, 2); // fixed Huffman codes
+
+    size_t size = data.size();
+    for (size_t i = 0; i < size; ) {
+        size_t run = 0;
+        if (i > 0) {
+            while (i + run < size && run < 258 && data[i + run] == data[i - 1]) {
+                run++;
+            }
+        }
+        if (run < 3) {
+            PutSymbol(writer, data[i]);
+            i++;
+            continue;
+        }
+        int code = 28;
+        while (LENGTH_BASE[code] > run) {
+            code--;
+        }
+        PutSymbol(writer, 257 + code);
+        writer.Put(static_cast<uint32_t>(run - LENGTH_BASE[code]), LENGTH_EXTRA[code]);
+        writer.PutCode(0, 5); // distance 1
+        i += run;
+    }
+    PutSymbol(writer, 256); // end of block
+    writer.Flush();
+
+    uint32_t adler = Adler32(data.data(), data.size());
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(adler >> shift));
+    }
+}
+
+void PutChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+{
+    auto put32 = [&](uint32_t value) {
+        uint8_t bytes[4] = {
+            static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+            static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)
+        };
+        file.write(reinterpret_cast<const char*>(bytes), 4);
+    };
+    put32(static_cast<uint32_t>(data.size()));
+    file.write(type, 4);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    uint32_t crc = Crc32(reinterpret_cast<const uint8_t*>(type), 4);
+    put32(Crc32(data.data(), data.size(), crc));
+}
+
+}
+
+bool WritePNG(const std::string& filename, const uint8_t* pixels, int width, int height, bool bottom_up)
+{
+    // every row starts with the filter type, Sub: difference to the pixel on the left
+    size_t stride = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> filtered((stride + 1) * height);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + stride * (bottom_up ? height - 1 - y : y);
+        uint8_t* out = &filtered[(stride + 1) * y];
+        *out++ = 1;
+        for (size_t x = 0; x < stride; x++) {
+            out[x] = static_cast<uint8_t>(row[x] - (x >= 4 ? row[x - 4] : 0));
+        }
+    }
+
+    std::vector<uint8_t> header(13);
+    for (int i = 0; i < 4; i++) {
+        header[i] = static_cast<uint8_t>(static_cast<uint32_t>(width) >> (24 - 8 * i));
+        header[4 + i] = static_cast<uint8_t>(static_cast<uint32_t>(height) >> (24 - 8 * i));
+    }
+    header[8] = 8;  // bits per channel
+    header[9] = 6;  // RGBA
+    // compression, filter and interlace methods are all 0
+
+    std::vector<uint8_t> compressed;
+    compressed.reserve(filtered.size() / 4);
+    Deflate(filtered, compressed);
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(PNG_SIGNATURE), sizeof(PNG_SIGNATURE));
+    PutChunk(file, "IHDR", header);
+    PutChunk(file, "IDAT", compressed);
+    PutChunk(file, "IEND", {});
+    if (file.fail()) {
+        Log::error("Failed to write PNG file ", filename);
+        return false;
+    }
+    return true;
+}
+
+bool IsFramePattern(const std::string& pattern)
+{
+    constexpr int MAX_WIDTH = 32;
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%') {
+            continue;
+        }
+        if (++i < pattern.size() && pattern[i] == '%') {
+            continue;
+        }
+        while (i < pattern.size() && (pattern[i] == '0' || pattern[i] == '-' || pattern[i] == '+' ||
+                                      pattern[i] == ' ')) {
+            i++;
+        }
+        int field_width = 0;
+        while (i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9') {
+            field_width = field_width * 10 + (pattern[i++] - '0');
+            if (field_width > MAX_WIDTH) {
+                return false;
+            }
+        }
+        if (i == pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i')) {
+            return false;
+        }
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+FrameWriter::FrameWriter(Format format, std::string path, int width, int height, size_t queue_length) :
+    format(format),
+    path(std::move(path)),
+    width(width),
+    height(height)
+{
+    if (width <= 0 || height <= 0) {
+        Log::critical("Wrong frame size ", width, "x", height);
+        throw std::invalid_argument("Wrong frame size");
+    }
+    // the pattern is handed to snprintf on the writer thread
+    if (this->format == Format::PNG && !IsFramePattern(this->path)) {
+        Log::critical("Frame file pattern needs exactly one integer conversion like %05d: ", this->path);
+        throw std::invalid_argument("Wrong frame file pattern");
+    }
+    if (this->format == Format::RAW) {
+#ifndef _WIN32
+        // a dead encoder shows up as a write error instead of killing us
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+        this->pipe = popen(this->path.c_str(), "w");
+        if (this->pipe == nullptr) {
+            Log::critical("Failed to start frame encoder ", this->path);
+            throw std::runtime_error("Failed to start encoder");
+        }
+    }
+
+    this->frames.resize(std::max<size_t>(queue_length, 1));
+    for (auto& frame : this->frames) {
+        frame.pixels.resize(static_cast<size_t>(width) * height * 4);
+        this->free.push_back(&frame);
+    }
+    Log::info("Writing ", width, "x", height, " frames ", this->format == Format::PNG ? "to " : "through ",
+              this->path);
+
+    this->writer = std::thread(&FrameWriter::WriterLoop, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+    {
+        std::lock_guard lock(this->mutex);
+        this->exit_requested = true;
+    }
+    this->cv.notify_all();
+    this->writer.join();
+    if (this->pipe != nullptr) {
+        int status = pclose(this->pipe);
+        if (status != 0) {
+            Log::warning("Frame encoder exited with status ", status);
+        }
+    }
+    Log::info("Frame writer done, ", this->submitted, " frames");
+    if (this->blocked > 0) {
+        Log::warning("Waited for the frame writer on ", this->blocked, " frames");
+    }
+}
+
+uint8_t* FrameWriter::Acquire()
+{
+    if (this->current == nullptr) {
+        std::unique_lock lock(this->mutex);
+        if (this->free.empty()) {
+            if (this->blocked++ == 0) {
+                Log::warning("Frame writer can't keep up, waiting");
+            }
+            this->cv.wait(lock, [this] { return !this->free.empty(); });
+        }
+        this->current = this->free.back();
+        this->free.pop_back();
+    }
+    return this->current->pixels.data();
+}
+
+void FrameWriter::Submit()
+{
+    if (this->current == nullptr) {
+        return;
+    }
+    this->current->number = this->submitted++;
+    {
+        std::lock_guard lock(this->mutex);
+        this->queue.push_back(this->current);
+    }
+    this->current = nullptr;
+    this->cv.notify_all();
+}
+
+bool FrameWriter::WriteRaw(const Frame& frame)
+{
+    size_t stride = static_cast<size_t>(this->width) * 4;
+    for (int y = this->height - 1; y >= 0; y--) {
+        if (std::fwrite(&frame.pixels[stride * y], 1, stride, this->pipe) != stride) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrameWriter::WriterLoop()
+{
+    std::vector<char> filename;
+    bool failed = false;
+    while (true) {
+        Frame* frame;
+        {
+            std::unique_lock lock(this->mutex);
+            this->cv.wait(lock, [this] { return this->exit_requested || !this->queue.empty(); });
+            if (this->queue.empty()) {
+                return;
+            }
+            frame = this->queue.front();
+            this->queue.pop_front();
+        }
+
+        // keep draining the queue after an error, the renderer shouldn't block
+        if (!failed && this->format == Format::PNG) {
+            auto number = static_cast<int>(frame->number);
+            filename.resize(std::snprintf(nullptr, 0, this->path.c_str(), number) + 1);
+            std::snprintf(filename.data(), filename.size(), this->path.c_str(), number);
+            failed = !WritePNG(filename.data(), frame->pixels.data(), this->width, this->height, true);
+        } else if (!failed) {
+            failed = !WriteRaw(*frame);
+            if (failed) {
+                Log::error("Failed to write frame ", frame->number, " to the encoder");
+            }
+        }
+
+        {
+            std::lock_guard lock(this->mutex);
+            this->free.push_back(frame);
+        }
+        this->cv.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <condition_variable>
+
+namespace UI
+{
+
+/**
+ * Writes rendered frames to disk or to an external encoder on a background
+ * thread, so that rendering only waits when the whole queue is full.
+ *
+ * PNG: path is a printf pattern for the file names, e.g. "out/frame_%05d.png"
+ * RAW: path is a shell command reading raw RGBA frames (top row first) from
+ *      stdin, e.g. "ffmpeg -f rawvideo -pix_fmt rgba -s 800x600 -r 30 -i - out.mp4"
+ *
+ * Frames are handed over in the glReadPixels layout (RGBA, bottom row first).
+ */
+class FrameWriter
+{
+public:
+    enum class Format { PNG, RAW };
+
+    // Throws on a size that isn't positive or a PNG pattern that isn't a frame pattern
+    FrameWriter(Format format, std::string path, int width, int height, size_t queue_length = 4);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // Buffer for the next frame, width * height * 4 bytes
+    uint8_t* Acquire();
+    // Queues the frame filled after the last Acquire
+    void Submit();
+
+    int Width() const { return this->width; }
+    int Height() const { return this->height; }
+
+private:
+    struct Frame {
+        std::vector<uint8_t> pixels;
+        uint64_t number = 0;
+    };
+
+    Format format;
+    std::string path;
+    int width, height;
+    FILE* pipe = nullptr;
+    uint64_t submitted = 0;
+
+    std::vector<Frame> frames;   // preallocated, never resized
+    std::vector<Frame*> free;    // guarded by mutex
+    uint64_t blocked = 0;        // frames Acquire waited for, guarded by mutex
+    Frame* current = nullptr;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Frame*> queue;
+    bool exit_requested = false;
+
+    void WriterLoop();
+    bool WriteRaw(const Frame& frame);
+};
+
+// True for a printf pattern with exactly one int conversion (%d or %i, with
+// optional flags 0-+ and space and a width) and nothing else but %%
+bool IsFramePattern(const std::string& pattern);
+
+// Encodes RGBA pixels (top row first) into a PNG file, returns false on error
+bool WritePNG(const std::string& filename, const uint8_t* pixels, int width, int height,
+              bool bottom_up = false);
+
+}
@@ -0,0 +1,120 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <filesystem>
+
+#include "frame_writer.hpp"
+#include "log.hpp"
+
+using namespace UI;
+
+std::vector<uint8_t> read_file(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+uint32_t be32(const uint8_t* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+uint32_t crc32(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc & 1) ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+// Checks the chunk structure and CRCs, returns the size of the IDAT data
+size_t check_png(const std::vector<uint8_t>& png, int width, int height)
+{
+    assert(png.size() > 8 && std::memcmp(png.data(), "\x89PNG\r\n\x1a\n", 8) == 0);
+    size_t idat = 0;
+    bool end = false;
+    for (size_t pos = 8; pos < png.size(); ) {
+        uint32_t length = be32(&png[pos]);
+        const uint8_t* type = &png[pos + 4];
+        assert(crc32(type, length + 4) == be32(&png[pos + 8 + length]));
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            assert(be32(type + 4) == uint32_t(width) && be32(type + 8) == uint32_t(height));
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            idat += length;
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            end = true;
+        }
+        pos += 12 + length;
+    }
+    assert(end);
+    return idat;
+}
+
+int main(void)
+{
+    constexpr int width = 64, height = 48;
+    auto dir = std::filesystem::temp_directory_path() / "frame_writer_test";
+    std::filesystem::create_directories(dir);
+
+    // flat background compresses well
+    std::vector<uint8_t> pixels(width * height * 4);
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        pixels[i + 2] = 50;
+        pixels[i + 3] = 255;
+    }
+    auto flat = (dir / "flat.png").string();
+    assert(WritePNG(flat, pixels.data(), width, height));
+    size_t compressed = check_png(read_file(flat), width, height);
+    Log::debug("flat frame: ", pixels.size(), " bytes raw, ", compressed, " compressed");
+    assert(compressed * 20 < pixels.size());
+
+    // noise doesn't, but still has to be a valid file
+    for (size_t i = 0; i < pixels.size(); i++) {
+        pixels[i] = static_cast<uint8_t>(i * 2654435761u >> 13);
+    }
+    auto noise = (dir / "noise.png").string();
+    assert(WritePNG(noise, pixels.data(), width, height, true));
+    check_png(read_file(noise), width, height);
+
+    // only patterns with a single int conversion make it to snprintf
+    assert(IsFramePattern("frame_%05d.png") && IsFramePattern("%d") && IsFramePattern("100%%_%-3i.png"));
+    assert(!IsFramePattern("frame.png") && !IsFramePattern("out/%s.png") && !IsFramePattern("a%n"));
+    assert(!IsFramePattern("%d_%d.png") && !IsFramePattern("%ld.png") && !IsFramePattern("%.3d") &&
+           !IsFramePattern("%*d") && !IsFramePattern("%99999999d") && !IsFramePattern("frame_%"));
+    bool thrown = false;
+    try {
+        FrameWriter writer(FrameWriter::Format::PNG, (dir / "%s.png").string(), width, height);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        FrameWriter writer(FrameWriter::Format::PNG, (dir / "%d.png").string(), 0, height);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // one file per submitted frame
+    {
+        FrameWriter writer(FrameWriter::Format::PNG, (dir / "frame_%03d.png").string(), width, height, 2);
+        for (int frame = 0; frame < 5; frame++) {
+            std::memset(writer.Acquire(), frame * 40, width * height * 4);
+            writer.Submit();
+        }
+    }
+    for (int frame = 0; frame < 5; frame++) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%03d.png", frame);
+        check_png(read_file((dir / name).string()), width, height);
+    }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
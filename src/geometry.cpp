@@ -0,0 +1,294 @@
+#include <cmath>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "log.hpp"
+#include "geometry.hpp"
+
+namespace Geometry {
+
+/*
+ * Mesh
+ */
+
+Mesh Mesh::LoadSTL(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        Log::critical("Failed to open STL file ", filename);
+        throw std::runtime_error("Failed to open STL file");
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    Mesh mesh;
+    // binary STL: 80 byte header, uint32 triangle count, 50 bytes per triangle;
+    // ASCII files start with "solid" too, so decide by the size
+    if (data.size() >= 84) {
+        uint32_t count;
+        std::copy_n(data.data() + 80, sizeof(count), reinterpret_cast<char*>(&count));
+        if (data.size() == 84 + 50 * static_cast<size_t>(count)) {
+            mesh.triangles.resize(count);
+            for (uint32_t t = 0; t < count; t++) {
+                // skip the normal, it is not needed
+                const char* record = data.data() + 84 + 50 * static_cast<size_t>(t) + 12;
+                std::copy_n(record, sizeof(Triangle::v), reinterpret_cast<char*>(mesh.triangles[t].v));
+            }
+            Log::info("Loaded binary STL ", filename, ", ", count, " triangles");
+            return mesh;
+        }
+    }
+
+    std::istringstream text(data);
+    std::string token;
+    Triangle triangle;
+    int vertex = 0;
+    while (text >> token) {
+        if (token != "vertex") {
+            continue;
+        }
+        auto& v = triangle.v[vertex];
+        text >> v[0] >> v[1] >> v[2];
+        if (++vertex == 3) {
+            mesh.triangles.push_back(triangle);
+            vertex = 0;
+        }
+    }
+    if (mesh.triangles.empty()) {
+        Log::critical("No triangles found in STL file ", filename);
+        throw std::runtime_error("Failed to parse STL file");
+    }
+    Log::info("Loaded ASCII STL ", filename, ", ", mesh.triangles.size(), " triangles");
+    return mesh;
+}
+
+void Mesh::Transform(double scale, Point offset)
+{
+    for (auto& triangle : this->triangles) {
+        for (auto& v : triangle.v) {
+            for (int axis = 0; axis < 3; axis++) {
+                v[axis] = static_cast<float>(v[axis] * scale + offset[axis]);
+            }
+        }
+    }
+}
+
+/*
+ * Scene
+ */
+
+Scene::Scene()
+{
+    this->materials.push_back(Material{}); // BACKGROUND
+}
+
+MaterialId Scene::AddMaterial(Material material)
+{
+    if (this->materials.size() > UINT8_MAX) {
+        throw std::runtime_error("Too many materials in scene");
+    }
+    this->materials.push_back(material);
+    return static_cast<MaterialId>(this->materials.size() - 1);
+}
+
+void Scene::AddSphere(Point center, double radius, MaterialId material)
+{
+    Shape shape{ShapeType::SPHERE, material, center, Point{radius, 0.0, 0.0}, {}, {}};
+    this->shapes.push_back(std::move(shape));
+}
+
+void Scene::AddBox(Point min, Point max, MaterialId material)
+{
+    Shape shape{ShapeType::BOX, material, min, max, {}, {}};
+    this->shapes.push_back(std::move(shape));
+}
+
+void Scene::AddMesh(const Mesh& mesh, MaterialId material)
+{
+    Shape shape{ShapeType::MESH, material, {}, {}, mesh.triangles, {}};
+    BuildBVH(shape);
+    this->shapes.push_back(std::move(shape));
+}
+
+MaterialGrid Scene::Voxelize(utils::Vec<int32_t, 3> size, Point offset) const
+{
+    auto [rows, cols, stacks] = size.elements;
+    MaterialGrid grid{size, {}};
+    grid.ids.assign(static_cast<size_t>(rows) * cols * stacks, BACKGROUND);
+
+    // every (i,j) column is a ray along k, rows are independent
+    utils::ParallelFor(rows, [&](size_t i) {
+        std::vector<double> hits;
+        for (int32_t j = 0; j < cols; j++) {
+            MaterialId* column = &grid.ids[(i * cols + j) * stacks];
+            double x = static_cast<double>(i) + offset[0];
+            double y = static_cast<double>(j) + offset[1];
+            for (const auto& shape : this->shapes) {
+                FillColumn(shape, x, y, offset[2], stacks, column, hits);
+            }
+        }
+    });
+    return grid;
+}
+
+void Scene::FillColumn(const Shape& shape, double x, double y, double z0,
+                       int32_t stacks, MaterialId* column, std::vector<double>& hits)
+{
+    // fills cells whose sample point z0 + k lies in [from, to]
+    auto fill = [&](double from, double to) {
+        auto k_min = std::max(0.0, std::ceil(from - z0));
+        auto k_max = std::min(stacks - 1.0, std::floor(to - z0));
+        for (auto k = static_cast<int32_t>(k_min); k <= static_cast<int32_t>(k_max); k++) {
+            column[k] = shape.material;
+        }
+    };
+
+    switch (shape.type) {
+        case ShapeType::SPHERE: {
+            double dx = x - shape.a[0];
+            double dy = y - shape.a[1];
+            double r = shape.b[0];
+            double h2 = r*r - dx*dx - dy*dy;
+            if (h2 >= 0.0) {
+                double h = std::sqrt(h2);
+                fill(shape.a[2] - h, shape.a[2] + h);
+            }
+            break;
+        }
+        case ShapeType::BOX: {
+            if (x >= shape.a[0] && x <= shape.b[0] &&
+                y >= shape.a[1] && y <= shape.b[1]) {
+                fill(shape.a[2], shape.b[2]);
+            }
+            break;
+        }
+        case ShapeType::MESH: {
+            CastRay(shape, x, y, hits);
+            std::sort(hits.begin(), hits.end());
+            // odd count means the ray grazed an edge, drop the last hit
+            for (size_t h = 0; h + 1 < hits.size(); h += 2) {
+                // half-open, so that touching solids do not overlap
+                fill(hits[h], std::nextafter(hits[h+1], -INFINITY));
+            }
+            break;
+        }
+    }
+}
+
+void Scene::CastRay(const Shape& shape, double x, double y, std::vector<double>& hits)
+{
+    hits.clear();
+    if (shape.bvh.empty()) {
+        return;
+    }
+
+    // edge function with a tie-break rule, so that a ray going exactly
+    // through an edge shared by two triangles is counted only once
+    auto owns = [x, y](const float* p0, const float* p1) {
+        double ex = double(p1[0]) - p0[0];
+        double ey = double(p1[1]) - p0[1];
+        double w = ex * (y - p0[1]) - ey * (x - p0[0]);
+        return w > 0.0 || (w == 0.0 && (ey > 0.0 || (ey == 0.0 && ex < 0.0)));
+    };
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const auto& node = shape.bvh[stack[--top]];
+        if (x < node.min[0] || x > node.max[0] || y < node.min[1] || y > node.max[1]) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        for (uint32_t t = node.first; t < node.first + node.count; t++) {
+            const auto& v = shape.triangles[t].v;
+            const float* a = v[0];
+            const float* b = v[1];
+            const float* c = v[2];
+            double area = (double(b[0]) - a[0]) * (double(c[1]) - a[1])
+                        - (double(b[1]) - a[1]) * (double(c[0]) - a[0]);
+            if (area == 0.0) {
+                continue; // parallel to the ray
+            }
+            if (area < 0.0) {
+                std::swap(b, c);
+                area = -area;
+            }
+            if (!owns(a, b) || !owns(b, c) || !owns(c, a)) {
+                continue;
+            }
+            // barycentric interpolation of z
+            double wa = ((double(c[0]) - b[0]) * (y - b[1]) - (double(c[1]) - b[1]) * (x - b[0])) / area;
+            double wb = ((double(a[0]) - c[0]) * (y - c[1]) - (double(a[1]) - c[1]) * (x - c[0])) / area;
+            double wc = 1.0 - wa - wb;
+            hits.push_back(wa * a[2] + wb * b[2] + wc * c[2]);
+        }
+    }
+}
+
+void Scene::BuildBVH(Shape& shape)
+{
+    constexpr uint32_t LEAF_SIZE = 4;
+    auto& triangles = shape.triangles;
+    auto& nodes = shape.bvh;
+    nodes.clear();
+    if (triangles.empty()) {
+        return;
+    }
+
+    auto centroid = [](const Triangle& t, int axis) {
+        return t.v[0][axis] + t.v[1][axis] + t.v[2][axis];
+    };
+
+    struct Task { uint32_t node, first, count; };
+    std::vector<Task> tasks;
+    nodes.push_back(BVHNode{});
+    tasks.push_back({0, 0, static_cast<uint32_t>(triangles.size())});
+
+    while (!tasks.empty()) {
+        auto [node_index, first, count] = tasks.back();
+        tasks.pop_back();
+
+        BVHNode node{{INFINITY, INFINITY}, {-INFINITY, -INFINITY}, first, count};
+        float c_min[2] = {INFINITY, INFINITY};
+        float c_max[2] = {-INFINITY, -INFINITY};
+        for (uint32_t t = first; t < first + count; t++) {
+            for (int axis = 0; axis < 2; axis++) {
+                for (const auto& v : triangles[t].v) {
+                    node.min[axis] = std::min(node.min[axis], v[axis]);
+                    node.max[axis] = std::max(node.max[axis], v[axis]);
+                }
+                c_min[axis] = std::min(c_min[axis], centroid(triangles[t], axis));
+                c_max[axis] = std::max(c_max[axis], centroid(triangles[t], axis));
+            }
+        }
+
+        if (count > LEAF_SIZE) {
+            // median split along the longer axis
+            int axis = (c_max[0] - c_min[0]) >= (c_max[1] - c_min[1]) ? 0 : 1;
+            auto begin = triangles.begin() + first;
+            auto middle = begin + count / 2;
+            std::nth_element(begin, middle, begin + count,
+                [&](const Triangle& l, const Triangle& r) {
+                    return centroid(l, axis) < centroid(r, axis);
+                });
+
+            auto left = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(BVHNode{});
+            nodes.push_back(BVHNode{});
+            node.first = left;
+            node.count = 0;
+            tasks.push_back({left, first, count / 2});
+            tasks.push_back({left + 1, first + count / 2, count - count / 2});
+        }
+        nodes[node_index] = node;
+    }
+}
+
+}
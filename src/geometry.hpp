@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "utilities.hpp"
+
+/*
+ * Scene description and voxelizer used to assign materials to
+ * simulation cells (e.g. FDTD dielectric objects).
+ *
+ * All coordinates are in cell units: cell (i,j,k) is sampled at
+ * point (i,j,k) + offset, where offset is given to Voxelize()
+ * (FDTD samples each E component on a half-cell staggered grid).
+ */
+namespace Geometry {
+
+using Point = utils::Vec<double, 3>;
+using MaterialId = uint8_t;
+
+// Material 0 is always the background (vacuum)
+constexpr MaterialId BACKGROUND = 0;
+
+struct Material {
+    double epsilon = 1.0; // relative dielectric constant
+    double sigma = 0.0;   // conductivity [S/m]
+};
+
+struct Triangle {
+    float v[3][3]; // three vertices, x y z
+};
+
+struct Mesh {
+    std::vector<Triangle> triangles;
+
+    // Binary or ASCII STL, e.g. a KiCad board exported to STL
+    static Mesh LoadSTL(const std::string& filename);
+
+    // v' = v * scale + offset, used to place a model (usually in mm)
+    // into cell coordinates
+    void Transform(double scale, Point offset);
+};
+
+// Material id per cell, cell (i,j,k) is at i*(cols*stacks) + j*stacks + k
+// (same order as the nested FDTD arrays, k is the fastest index)
+struct MaterialGrid {
+    utils::Vec<int32_t, 3> size;
+    std::vector<MaterialId> ids;
+
+    MaterialId At(int32_t i, int32_t j, int32_t k) const
+    {
+        return ids[(static_cast<size_t>(i) * size[1] + j) * size[2] + k];
+    }
+};
+
+class Scene {
+public:
+    Scene();
+
+    MaterialId AddMaterial(Material material);
+    const Material& GetMaterial(MaterialId id) const { return materials[id]; }
+
+    // Objects added later override the earlier ones where they overlap
+    void AddSphere(Point center, double radius, MaterialId material);
+    void AddBox(Point min, Point max, MaterialId material);
+    // Mesh has to be closed (watertight), inside is determined by parity
+    void AddMesh(const Mesh& mesh, MaterialId material);
+
+    MaterialGrid Voxelize(utils::Vec<int32_t, 3> size, Point offset) const;
+
+private:
+    enum class ShapeType { SPHERE, BOX, MESH };
+
+    struct BVHNode {
+        float min[2], max[2]; // only x,y - rays are cast along z
+        uint32_t first;       // first triangle (leaf) or left child (inner)
+        uint32_t count;       // 0 for inner nodes
+    };
+
+    struct Shape {
+        ShapeType type;
+        MaterialId material;
+        Point a, b; // sphere: center, (radius,-,-); box: min, max
+        std::vector<Triangle> triangles;
+        std::vector<BVHNode> bvh;
+    };
+
+    std::vector<Material> materials;
+    std::vector<Shape> shapes;
+
+    static void BuildBVH(Shape& shape);
+    static void CastRay(const Shape& shape, double x, double y, std::vector<double>& hits);
+    static void FillColumn(const Shape& shape, double x, double y, double z0,
+                           int32_t stacks, MaterialId* column, std::vector<double>& hits);
+};
+
+}
@@ -0,0 +1,88 @@
+#include <cmath>
+#include <cassert>
+#include <iostream>
+
+#include "geometry.hpp"
+#include "log.hpp"
+
+using namespace Geometry;
+
+// closed axis aligned cube made of 12 triangles
+Mesh make_cube(float lo, float hi)
+{
+    float c[8][3] = {
+        {lo, lo, lo}, {hi, lo, lo}, {hi, hi, lo}, {lo, hi, lo},
+        {lo, lo, hi}, {hi, lo, hi}, {hi, hi, hi}, {lo, hi, hi},
+    };
+    int faces[12][3] = {
+        {0, 2, 1}, {0, 3, 2}, // bottom
+        {4, 5, 6}, {4, 6, 7}, // top
+        {0, 1, 5}, {0, 5, 4},
+        {1, 2, 6}, {1, 6, 5},
+        {2, 3, 7}, {2, 7, 6},
+        {3, 0, 4}, {3, 4, 7},
+    };
+    Mesh mesh;
+    for (auto& face : faces) {
+        Triangle t;
+        for (int v = 0; v < 3; v++) {
+            for (int axis = 0; axis < 3; axis++) {
+                t.v[v][axis] = c[face[v]][axis];
+            }
+        }
+        mesh.triangles.push_back(t);
+    }
+    return mesh;
+}
+
+size_t count(const MaterialGrid& grid, MaterialId id)
+{
+    size_t n = 0;
+    for (auto m : grid.ids) {
+        n += (m == id);
+    }
+    return n;
+}
+
+int main(void)
+{
+    utils::Vec<int32_t, 3> size{40, 40, 40};
+
+    // sphere volume roughly matches 4/3 pi r^3
+    Scene spheres;
+    auto a = spheres.AddMaterial({4.0, 0.0});
+    spheres.AddSphere(Point{20.0, 20.0, 20.0}, 10.0, a);
+    auto grid = spheres.Voxelize(size, Point{0.0, 0.0, 0.0});
+    double expected = 4.0 / 3.0 * M_PI * 1000.0;
+    Log::debug("sphere voxels: ", count(grid, a), " expected ~", expected);
+    assert(std::abs(count(grid, a) - expected) / expected < 0.02);
+    assert(grid.At(20, 20, 20) == a);
+    assert(grid.At(20, 20, 31) == BACKGROUND);
+
+    // later objects override earlier ones
+    auto b = spheres.AddMaterial({30.0, 0.3});
+    spheres.AddSphere(Point{20.0, 20.0, 20.0}, 5.0, b);
+    grid = spheres.Voxelize(size, Point{0.0, 0.0, 0.0});
+    assert(grid.At(20, 20, 20) == b);
+    assert(grid.At(20, 20, 28) == a);
+
+    // closed mesh has to give the same result as the equivalent box
+    Scene box, mesh;
+    auto m_box = box.AddMaterial({2.0, 0.0});
+    auto m_mesh = mesh.AddMaterial({2.0, 0.0});
+    box.AddBox(Point{5.0, 5.0, 5.0}, Point{25.0, 25.0, 25.0}, m_box);
+    mesh.AddMesh(make_cube(5.0f, 25.0f), m_mesh);
+    auto offset = Point{0.5, 0.5, 0.5};
+    auto box_grid = box.Voxelize(size, offset);
+    auto mesh_grid = mesh.Voxelize(size, offset);
+    Log::debug("box voxels: ", count(box_grid, m_box), " mesh voxels: ", count(mesh_grid, m_mesh));
+    assert(count(box_grid, m_box) == 20 * 20 * 20);
+    assert(box_grid.ids == mesh_grid.ids);
+
+    // rays going exactly through shared edges and vertices
+    auto edge_grid = mesh.Voxelize(size, Point{0.0, 0.0, 0.5});
+    Log::debug("mesh voxels (rays through edges): ", count(edge_grid, m_mesh));
+    assert(count(edge_grid, m_mesh) == 20 * 20 * 20);
+
+    return 0;
+}
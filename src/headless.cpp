@@ -0,0 +1,142 @@
+#include <GL/glew.h>
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "log.hpp"
+#include "headless.hpp"
+
+namespace UI {
+
+#ifndef _WIN32
+
+bool HeadlessContext::Init(int width, int height)
+{
+    EGLDisplay egl_display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display != nullptr) {
+        egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+#endif
+    if (egl_display == EGL_NO_DISPLAY) {
+        egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major, minor;
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+        Log::error("EGL could not be initialized! Error: ", eglGetError());
+        return false;
+    }
+    this->display = egl_display;
+
+    const EGLint config_attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint configs = 0;
+    eglChooseConfig(egl_display, config_attributes, &config, 1, &configs);
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        Log::error("EGL does not support desktop OpenGL");
+        Release();
+        return false;
+    }
+    // no config is fine for surfaceless contexts
+    this->context = eglCreateContext(egl_display, configs > 0 ? config : nullptr, EGL_NO_CONTEXT, nullptr);
+    if (this->context == EGL_NO_CONTEXT) {
+        Log::error("EGL context could not be created! Error: ", eglGetError());
+        this->context = nullptr;
+        Release();
+        return false;
+    }
+
+    // without EGL_KHR_surfaceless_context a tiny pbuffer is needed to make the context current
+    if (!eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context)) {
+        const EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        if (configs > 0) {
+            this->surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attributes);
+        }
+        if (this->surface == EGL_NO_SURFACE ||
+            !eglMakeCurrent(egl_display, this->surface, this->surface, this->context)) {
+            Log::error("EGL context could not be made current! Error: ", eglGetError());
+            Release();
+            return false;
+        }
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum glew_status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLX extensions are not needed, only the GL ones
+    if (glew_status == GLEW_ERROR_NO_GLX_DISPLAY) {
+        glew_status = GLEW_OK;
+    }
+#endif
+    if (glew_status != GLEW_OK || !GLEW_VERSION_3_0) {
+        Log::error("GLEW init failed or OpenGL 3.0 (framebuffer objects) not available");
+        Release();
+        return false;
+    }
+
+    glGenFramebuffers(1, &this->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glGenRenderbuffers(2, this->renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        Log::error("Offscreen framebuffer is not complete");
+        Release();
+        return false;
+    }
+
+    Log::info("Headless OpenGL ", glGetString(GL_VERSION), ", renderer ", glGetString(GL_RENDERER),
+              ", ", width, "x", height);
+    return true;
+}
+
+void HeadlessContext::Release()
+{
+    if (this->display == nullptr) {
+        return;
+    }
+    if (this->framebuffer != 0) {
+        glDeleteRenderbuffers(2, this->renderbuffers);
+        glDeleteFramebuffers(1, &this->framebuffer);
+        this->framebuffer = 0;
+    }
+    eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (this->surface != nullptr) {
+        eglDestroySurface(this->display, this->surface);
+        this->surface = nullptr;
+    }
+    if (this->context != nullptr) {
+        eglDestroyContext(this->display, this->context);
+        this->context = nullptr;
+    }
+    eglTerminate(this->display);
+    this->display = nullptr;
+}
+
+#else
+
+bool HeadlessContext::Init([[maybe_unused]] int width, [[maybe_unused]] int height)
+{
+    Log::error("Headless rendering is not supported on Windows");
+    return false;
+}
+
+void HeadlessContext::Release()
+{
+}
+
+#endif
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+namespace UI
+{
+
+/**
+ * OpenGL context without a window or a display, for rendering on servers.
+ *
+ * Uses EGL (Mesa's surfaceless platform when available, the default
+ * display otherwise) and renders into a framebuffer object of the given
+ * size, which stays bound, so that the rest of the rendering code doesn't
+ * have to know about it. Read the result back with glReadPixels.
+ *
+ * Not available on Windows, Init() returns false there.
+ */
+class HeadlessContext
+{
+public:
+    ~HeadlessContext() { Release(); }
+
+    // Creates the context, makes it current and initializes GLEW
+    bool Init(int width, int height);
+    void Release();
+    bool Active() const { return this->context != nullptr; }
+
+private:
+    // EGL handles, kept opaque so that the EGL headers stay in headless.cpp
+    void* display = nullptr;
+    void* context = nullptr;
+    void* surface = nullptr;
+    uint32_t framebuffer = 0;
+    uint32_t renderbuffers[2] = {0, 0}; // colour, depth
+};
+
+}
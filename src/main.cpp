@@ -1,3 +1,7 @@
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <charconv>
 #include <iostream>
 #include <memory>
 
@@ -9,19 +13,134 @@
 #include "simulations/playback.hpp"
 #include "simulations/fdtd.hpp"
 
-int main(void)
+/*
+ * Headless rendering on machines without a display, e.g.
+ *   gameof3dlife --headless --png "frames/frame_%05d.png"
+ *   gameof3dlife --headless --playback gol3d.sim --size 1280x720 \
+ *       --pipe "ffmpeg -f rawvideo -pix_fmt rgba -s 1280x720 -r 30 -i - gol3d.mp4"
+ * --every N shows (or writes) only every Nth step, with or without a display.
+ */
+struct Options {
+    bool headless = false;
+    uint32_t every = 0;
+    std::string playback;
+    std::string png = "frame_%05d.png";
+    std::string pipe;
+    int width = 800;
+    int height = 600;
+    uint64_t frames = 1000;
+};
+
+// The whole of text as a number > 0
+template <typename T>
+bool ParsePositive(const char* text, T& value)
+{
+    const char* end = text + std::strlen(text);
+    auto [last, error] = std::from_chars(text, end, value);
+    return error == std::errc() && last == end && value > 0;
+}
+
+bool ParseArguments(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--every" && has_value) {
+            if (!ParsePositive(argv[++i], options.every)) {
+                Log::error("--every needs a positive number of steps");
+                return false;
+            }
+        } else if (arg == "--playback" && has_value) {
+            options.playback = argv[++i];
+        } else if (arg == "--png" && has_value) {
+            options.png = argv[++i];
+            if (!UI::IsFramePattern(options.png)) {
+                Log::error("--png needs a pattern with one integer conversion, like frame_%05d.png");
+                return false;
+            }
+        } else if (arg == "--pipe" && has_value) {
+            options.pipe = argv[++i];
+        } else if (arg == "--frames" && has_value) {
+            if (!ParsePositive(argv[++i], options.frames)) {
+                Log::error("--frames needs a positive number of frames");
+                return false;
+            }
+        } else if (arg == "--size" && has_value) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 ||
+                options.width <= 0 || options.height <= 0) {
+                Log::error("--size needs a positive width and height, like 1280x720");
+                return false;
+            }
+        } else {
+            Log::error("Unknown or incomplete argument ", arg);
+            Log::info("Usage: ", argv[0], " [--every N] [--headless [--playback FILE] [--size WxH] [--frames N]",
+                      " [--png PATTERN | --pipe COMMAND]]");
+            return false;
+        }
+    }
+    return true;
+}
+
+// The simulation shown, with or without a display
+std::unique_ptr<Simulation::BaseSimulation> MakeSimulation()
+{
+    return std::make_unique<Simulation::GameOfLife3D>(50, 50, 50);
+    //return std::make_unique<Simulation::FDTD_2D>(100, 100);
+    //return std::make_unique<Simulation::FDTD_3D>(40, 40, 40);
+}
+
+int RunHeadless(const Options& options)
 {
+    UI::Window window{options.width, options.height};
+    if (window.InitHeadless() != 0) {
+        return 1;
+    }
+    window.SetThroughput(options.every);
+    if (options.playback.empty()) {
+        window.SetSimulation(MakeSimulation());
+    } else {
+        window.SetSimulation(std::make_unique<Simulation::Playback>(options.playback));
+    }
+
+    auto format = options.pipe.empty() ? UI::FrameWriter::Format::PNG : UI::FrameWriter::Format::RAW;
+    UI::FrameWriter writer(format, options.pipe.empty() ? options.png : options.pipe,
+                           options.width, options.height);
+    window.RunHeadless(writer, options.frames);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options)) {
+        return 1;
+    }
+    if (options.headless) {
+        return RunHeadless(options);
+    }
+
     Log::info("Press 'q' to quit");
 
     UI::Window window{800, 600};
     window.Init();
+    window.SetThroughput(options.every);
 
 
-    window.SetSimulation(
-        std::make_unique<Simulation::GameOfLife3D>(50, 50, 50)
-        //std::make_unique<Simulation::FDTD_2D>(100, 100)
-        //std::make_unique<Simulation::FDTD_3D>(40, 40, 40)
-    );
+    window.SetSimulation(MakeSimulation());
+
+/*
+    // time series of a few field values instead of whole frames
+    auto fdtd = std::make_unique<Simulation::FDTD_3D>(40, 40, 40);
+    fdtd->AttachProbes(std::make_unique<Simulation::Probes>("fdtd3d.probe",
+        std::vector<Simulation::ProbeSpec>{
+            {"center", Simulation::Field::EZ, {20, 20, 20}, {20, 20, 20}},
+            {"plane",  Simulation::Field::EZ, {0, 0, 20}, {39, 39, 20}, 10},
+        }
+    ));
+    window.SetSimulation(std::move(fdtd));
+*/
 
 /*
 #if 1
@@ -0,0 +1,233 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "mesher.hpp"
+
+namespace UI {
+
+namespace {
+
+// 0 is never a visible colour (alpha is 0), so it marks "no face" in the masks
+uint32_t Pack(utils::Color color)
+{
+    uint32_t packed;
+    std::memcpy(&packed, &color, sizeof(packed));
+    return color[3] != 0 ? packed : 0;
+}
+
+utils::Color Unpack(uint32_t packed)
+{
+    uint8_t c[4];
+    std::memcpy(c, &packed, sizeof(c));
+    return utils::Color{c[0], c[1], c[2], c[3]};
+}
+
+}
+
+void VoxelMesher::Resize(const utils::Vec<int32_t, 3>& new_size)
+{
+    this->size = new_size;
+    for (int axis = 0; axis < 3; axis++) {
+        this->bricks[axis] = (new_size[axis] + BRICK - 1) / BRICK;
+    }
+    auto [brick_rows, brick_cols, brick_stacks] = this->bricks.elements;
+    this->brick_vertices.assign(static_cast<size_t>(brick_rows) * brick_cols * brick_stacks, {});
+    this->previous.clear();
+}
+
+bool VoxelMesher::Update(const VoxelBuffer& voxels)
+{
+    bool resized = voxels.size.elements != this->size.elements;
+    if (resized) {
+        Resize(voxels.size);
+    } else if (voxels.version == this->version) {
+        this->rebuilt = 0;
+        return false;
+    }
+    this->version = voxels.version;
+
+    auto [brick_rows, brick_cols, brick_stacks] = this->bricks.elements;
+    int32_t brick_count = brick_rows * brick_cols * brick_stacks;
+
+    // changed bricks and their neighbours
+    std::vector<uint8_t> dirty(brick_count, resized ? 1 : 0);
+    if (!resized) {
+        for (int32_t brick = 0; brick < brick_count; brick++) {
+            if (!BrickChanged(voxels, brick)) {
+                continue;
+            }
+            int32_t br = (brick / brick_cols) % brick_rows;
+            int32_t bc = brick % brick_cols;
+            int32_t bs = brick / (brick_rows * brick_cols);
+            for (int32_t s = std::max(bs - 1, 0); s <= std::min(bs + 1, brick_stacks - 1); s++) {
+                for (int32_t r = std::max(br - 1, 0); r <= std::min(br + 1, brick_rows - 1); r++) {
+                    for (int32_t c = std::max(bc - 1, 0); c <= std::min(bc + 1, brick_cols - 1); c++) {
+                        int32_t manhattan = std::abs(s - bs) + std::abs(r - br) + std::abs(c - bc);
+                        if (manhattan <= 1) {
+                            dirty[s * (brick_rows * brick_cols) + r * brick_cols + c] = 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<int32_t> rebuild;
+    for (int32_t brick = 0; brick < brick_count; brick++) {
+        if (dirty[brick]) {
+            rebuild.push_back(brick);
+        }
+    }
+    this->rebuilt = rebuild.size();
+    if (rebuild.empty()) {
+        return false;
+    }
+
+    utils::ParallelFor(rebuild.size(), [&](size_t i) {
+        MeshBrick(voxels, rebuild[i], this->brick_vertices[rebuild[i]]);
+    });
+    this->previous.assign(voxels.colors.begin(), voxels.colors.end());
+
+    size_t total = 0;
+    for (const auto& brick : this->brick_vertices) {
+        total += brick.size();
+    }
+    this->vertices.clear();
+    this->vertices.reserve(total);
+    for (const auto& brick : this->brick_vertices) {
+        this->vertices.insert(this->vertices.end(), brick.begin(), brick.end());
+    }
+    return true;
+}
+
+bool VoxelMesher::BrickChanged(const VoxelBuffer& voxels, int32_t brick) const
+{
+    auto [rows, cols, stacks] = this->size.elements;
+    auto [brick_rows, brick_cols, brick_stacks] = this->bricks.elements;
+    int32_t row_begin = ((brick / brick_cols) % brick_rows) * BRICK;
+    int32_t col_begin = (brick % brick_cols) * BRICK;
+    int32_t stack_begin = (brick / (brick_rows * brick_cols)) * BRICK;
+    int32_t row_end = std::min(row_begin + BRICK, rows);
+    int32_t col_end = std::min(col_begin + BRICK, cols);
+    int32_t stack_end = std::min(stack_begin + BRICK, stacks);
+
+    // rows of the brick are contiguous in memory
+    size_t line = sizeof(utils::Color) * (col_end - col_begin);
+    for (int32_t stack = stack_begin; stack < stack_end; stack++) {
+        for (int32_t row = row_begin; row < row_end; row++) {
+            size_t index = static_cast<size_t>(stack) * rows * cols + row * cols + col_begin;
+            if (std::memcmp(&voxels.colors[index], &this->previous[index], line) != 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void VoxelMesher::MeshBrick(const VoxelBuffer& voxels, int32_t brick, std::vector<MeshVertex>& out) const
+{
+    out.clear();
+    auto [brick_rows, brick_cols, brick_stacks] = this->bricks.elements;
+    int32_t begin[3] = {
+        ((brick / brick_cols) % brick_rows) * BRICK,
+        (brick % brick_cols) * BRICK,
+        (brick / (brick_rows * brick_cols)) * BRICK,
+    };
+    int32_t end[3];
+    for (int axis = 0; axis < 3; axis++) {
+        end[axis] = std::min(begin[axis] + BRICK, this->size[axis]);
+    }
+
+    auto [rows, cols, stacks] = this->size.elements;
+    // p = {row, col, stack}
+    auto color_at = [&](const int32_t p[3]) -> uint32_t {
+        if (p[0] < 0 || p[0] >= rows || p[1] < 0 || p[1] >= cols || p[2] < 0 || p[2] >= stacks) {
+            return 0;
+        }
+        return Pack(voxels.colors[static_cast<size_t>(p[2]) * rows * cols + p[0] * cols + p[1]]);
+    };
+
+    uint32_t mask[BRICK * BRICK];
+    for (int axis = 0; axis < 3; axis++) {
+        // u, v, axis is a right handed system
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        int32_t width = end[u] - begin[u];
+        int32_t height = end[v] - begin[v];
+
+        for (int32_t side = -1; side <= 1; side += 2) {
+            for (int32_t slice = begin[axis]; slice < end[axis]; slice++) {
+                // faces of this slice looking towards side
+                for (int32_t j = 0; j < height; j++) {
+                    for (int32_t i = 0; i < width; i++) {
+                        int32_t p[3];
+                        p[axis] = slice;
+                        p[u] = begin[u] + i;
+                        p[v] = begin[v] + j;
+                        uint32_t color = color_at(p);
+                        p[axis] += side;
+                        mask[j * BRICK + i] = (color != 0 && color_at(p) == 0) ? color : 0;
+                    }
+                }
+
+                // greedy merging: grow along u, then along v while the whole row matches
+                for (int32_t j = 0; j < height; j++) {
+                    for (int32_t i = 0; i < width; ) {
+                        uint32_t color = mask[j * BRICK + i];
+                        if (color == 0) {
+                            i++;
+                            continue;
+                        }
+                        int32_t w = 1;
+                        while (i + w < width && mask[j * BRICK + i + w] == color) {
+                            w++;
+                        }
+                        int32_t h = 1;
+                        for (; j + h < height; h++) {
+                            bool row_matches = true;
+                            for (int32_t k = 0; k < w; k++) {
+                                if (mask[(j + h) * BRICK + i + k] != color) {
+                                    row_matches = false;
+                                    break;
+                                }
+                            }
+                            if (!row_matches) {
+                                break;
+                            }
+                        }
+                        for (int32_t l = 0; l < h; l++) {
+                            std::fill_n(&mask[(j + l) * BRICK + i], w, 0u);
+                        }
+
+                        // voxels are centred on integer coordinates
+                        MeshVertex corners[4];
+                        auto quad_color = Unpack(color);
+                        float u0 = begin[u] + i - 0.5f;
+                        float v0 = begin[v] + j - 0.5f;
+                        float uv[4][2] = {{u0, v0}, {u0 + w, v0}, {u0 + w, v0 + h}, {u0, v0 + h}};
+                        for (int c = 0; c < 4; c++) {
+                            corners[c].position[axis] = slice + 0.5f * side;
+                            corners[c].position[u] = uv[c][0];
+                            corners[c].position[v] = uv[c][1];
+                            corners[c].normal[0] = corners[c].normal[1] = corners[c].normal[2] = 0;
+                            corners[c].normal[3] = 0;
+                            corners[c].normal[axis] = static_cast<int8_t>(127 * side);
+                            corners[c].color = quad_color;
+                        }
+                        // counter-clockwise when looking at the face from outside
+                        static constexpr int FRONT[6] = {0, 1, 2, 2, 3, 0};
+                        static constexpr int BACK[6] = {0, 3, 2, 2, 1, 0};
+                        const int* order = side > 0 ? FRONT : BACK;
+                        for (int c = 0; c < 6; c++) {
+                            out.push_back(corners[order[c]]);
+                        }
+                        i += w;
+                    }
+                }
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "utilities.hpp"
+#include "voxel.hpp"
+
+namespace UI
+{
+
+struct MeshVertex {
+    float position[3];
+    int8_t normal[4];   // only xyz used, padded to 4 bytes
+    utils::Color color;
+};
+
+static_assert(sizeof(MeshVertex) == 20, "MeshVertex is uploaded to the GPU as is");
+
+/**
+ * Surface mesh of the visible voxels, for rendering with alpha off.
+ *
+ * Only faces between a visible (alpha != 0) and an invisible voxel (or
+ * the border of the grid) are emitted, and coplanar faces of the same
+ * colour are merged into larger quads (greedy meshing). Every quad is
+ * two triangles, 6 vertices, so that the mesh can be drawn without an
+ * index buffer.
+ *
+ * The grid is split into bricks of BRICK^3 voxels, each with its own
+ * mesh. Update() compares the colours with the previous call and only
+ * re-meshes the bricks that changed (and their neighbours, whose border
+ * faces might have changed too).
+ */
+class VoxelMesher
+{
+public:
+    static constexpr int32_t BRICK = 16;
+
+    // Returns true when the mesh changed
+    bool Update(const VoxelBuffer& voxels);
+
+    // All the bricks concatenated
+    const std::vector<MeshVertex>& Vertices() const { return this->vertices; }
+    size_t QuadCount() const { return this->vertices.size() / 6; }
+    // Number of bricks re-meshed by the last Update
+    size_t RebuiltBricks() const { return this->rebuilt; }
+
+private:
+    utils::Vec<int32_t, 3> size{0, 0, 0};
+    utils::Vec<int32_t, 3> bricks{0, 0, 0}; // number of bricks along each axis
+    std::vector<utils::Color> previous;      // colours at the last Update
+    std::vector<std::vector<MeshVertex>> brick_vertices;
+    std::vector<MeshVertex> vertices;
+    size_t rebuilt = 0;
+    uint64_t version = 0; // VoxelBuffer::version at the last Update
+
+    void Resize(const utils::Vec<int32_t, 3>& new_size);
+    bool BrickChanged(const VoxelBuffer& voxels, int32_t brick) const;
+    void MeshBrick(const VoxelBuffer& voxels, int32_t brick, std::vector<MeshVertex>& out) const;
+};
+
+}
@@ -0,0 +1,78 @@
+#include <random>
+#include <cassert>
+#include <iostream>
+
+#include "mesher.hpp"
+#include "log.hpp"
+
+using namespace UI;
+
+const auto red = utils::Color{255, 0, 0, 255};
+const auto blue = utils::Color{0, 0, 255, 255};
+const auto transparent = utils::Color{0, 0, 0, 0};
+
+void fill(VoxelBuffer& voxels, utils::Color color)
+{
+    std::fill(voxels.colors.begin(), voxels.colors.end(), color);
+    voxels.MarkAllChanged();
+}
+
+size_t index(const VoxelBuffer& voxels, int32_t row, int32_t col, int32_t stack)
+{
+    auto [rows, cols, stacks] = voxels.size.elements;
+    return static_cast<size_t>(stack) * rows * cols + row * cols + col;
+}
+
+int main(void)
+{
+    VoxelBuffer voxels;
+    voxels.Resize({40, 40, 40});
+    VoxelMesher mesher;
+
+    // solid block spanning several bricks: one quad per side
+    fill(voxels, red);
+    assert(mesher.Update(voxels));
+    Log::debug("solid block quads: ", mesher.QuadCount());
+    assert(mesher.QuadCount() == 6 * 3 * 3);
+    assert(mesher.Vertices().size() == 6 * mesher.QuadCount());
+
+    // nothing changed, nothing to rebuild
+    assert(!mesher.Update(voxels));
+    assert(mesher.RebuiltBricks() == 0);
+
+    // single voxel, only its brick and the neighbours get re-meshed
+    fill(voxels, transparent);
+    mesher.Update(voxels);
+    assert(mesher.QuadCount() == 0);
+    voxels.BeginFrame();
+    voxels.SetColor(index(voxels, 20, 20, 20), red);
+    assert(mesher.Update(voxels));
+    Log::debug("rebuilt bricks for a single voxel: ", mesher.RebuiltBricks());
+    assert(mesher.RebuiltBricks() <= 7);
+    assert(mesher.QuadCount() == 6);
+
+    // coplanar faces of different colours are not merged
+    voxels.BeginFrame();
+    voxels.SetColor(index(voxels, 20, 21, 20), red);
+    mesher.Update(voxels);
+    assert(mesher.QuadCount() == 6);
+    voxels.BeginFrame();
+    voxels.SetColor(index(voxels, 20, 21, 20), blue);
+    mesher.Update(voxels);
+    assert(mesher.QuadCount() == 10);
+
+    // dense state (a ball) compared to drawing 6 faces per visible voxel
+    size_t visible = 0;
+    for (size_t i = 0; i < voxels.Count(); i++) {
+        auto p = voxels.Position(i);
+        int32_t dr = p[0] - 20, dc = p[1] - 20, ds = p[2] - 20;
+        voxels.colors[i] = dr * dr + dc * dc + ds * ds < 18 * 18 ? red : transparent;
+        visible += voxels.colors[i][3] != 0;
+    }
+    voxels.MarkAllChanged();
+    mesher.Update(voxels);
+    Log::debug("ball: ", 2 * 6 * visible, " triangles as cubes, ", 2 * mesher.QuadCount(), " meshed");
+    assert(mesher.QuadCount() * 20 < 6 * visible);
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include <cmath>
+#include <algorithm>
+
+#include "pyramid.hpp"
+
+namespace UI {
+
+namespace {
+
+size_t CellIndex(const utils::Vec<int32_t, 3>& size, int32_t row, int32_t col, int32_t stack)
+{
+    return static_cast<size_t>(stack) * size[0] * size[1] + static_cast<size_t>(row) * size[1] + col;
+}
+
+}
+
+void VoxelPyramid::Resize(const utils::Vec<int32_t, 3>& new_size)
+{
+    this->size = new_size;
+    for (int axis = 0; axis < 3; axis++) {
+        this->brick_grid[axis] = (new_size[axis] + BRICK - 1) / BRICK;
+    }
+    for (int level = 0; level < LEVELS; level++) {
+        int32_t scale = 1 << level;
+        for (int axis = 0; axis < 3; axis++) {
+            this->level_size[level][axis] = (new_size[axis] + scale - 1) / scale;
+        }
+        if (level > 0) {
+            auto [rows, cols, stacks] = this->level_size[level].elements;
+            this->levels[level].assign(static_cast<size_t>(rows) * cols * stacks, utils::Color{0, 0, 0, 0});
+        }
+    }
+    auto [brick_rows, brick_cols, brick_stacks] = this->brick_grid.elements;
+    this->bricks.assign(static_cast<size_t>(brick_rows) * brick_cols * brick_stacks, Brick{});
+}
+
+bool VoxelPyramid::Update(const VoxelBuffer& voxels, const std::array<float, 3>& eye, float pixel_angle)
+{
+    bool resized = voxels.size.elements != this->size.elements;
+    if (resized) {
+        Resize(voxels.size);
+    }
+
+    // a new simulation starts counting versions again
+    std::vector<uint8_t> dirty(this->bricks.size(), resized || voxels.version < this->version ? 1 : 0);
+    if (!resized && voxels.version > this->version) {
+        voxels.MarkChangedBricks(this->version, BRICK, dirty);
+    }
+    this->version = voxels.version;
+
+    std::vector<int32_t> rebuild;
+    for (size_t brick = 0; brick < this->bricks.size(); brick++) {
+        if (dirty[brick]) {
+            rebuild.push_back(static_cast<int32_t>(brick));
+        }
+    }
+    this->rebuilt = rebuild.size();
+    utils::ParallelFor(rebuild.size(), [&](size_t i) {
+        BuildBrick(voxels, rebuild[i]);
+    });
+
+    std::vector<int32_t> collect;
+    for (size_t brick = 0; brick < this->bricks.size(); brick++) {
+        auto& state = this->bricks[brick];
+        int level = SelectLevel(static_cast<int32_t>(brick), eye, pixel_angle);
+        if (dirty[brick] || level != state.level) {
+            state.level = level;
+            collect.push_back(static_cast<int32_t>(brick));
+        }
+    }
+    if (collect.empty()) {
+        return false;
+    }
+    utils::ParallelFor(collect.size(), [&](size_t i) {
+        CollectBrick(voxels, collect[i]);
+    });
+
+    size_t total = 0;
+    for (const auto& brick : this->bricks) {
+        total += brick.cells.size();
+    }
+    this->cells.clear();
+    this->cells.reserve(total);
+    for (const auto& brick : this->bricks) {
+        this->cells.insert(this->cells.end(), brick.cells.begin(), brick.cells.end());
+    }
+    return true;
+}
+
+// Downsamples the voxels of the brick through all the levels
+void VoxelPyramid::BuildBrick(const VoxelBuffer& voxels, int32_t brick)
+{
+    auto [brick_rows, brick_cols, brick_stacks] = this->brick_grid.elements;
+    int32_t begin[3] = {
+        ((brick / brick_cols) % brick_rows) * BRICK,
+        (brick % brick_cols) * BRICK,
+        (brick / (brick_rows * brick_cols)) * BRICK,
+    };
+
+    for (int level = 1; level < LEVELS; level++) {
+        const auto& child_size = this->level_size[level - 1];
+        const auto& cell_size = this->level_size[level];
+        const utils::Color* children = level == 1 ? voxels.colors.data() : this->levels[level - 1].data();
+        int32_t first[3], last[3];
+        for (int axis = 0; axis < 3; axis++) {
+            first[axis] = begin[axis] >> level;
+            last[axis] = std::min((begin[axis] + BRICK) >> level, cell_size[axis]);
+        }
+
+        for (int32_t stack = first[2]; stack < last[2]; stack++) {
+            for (int32_t row = first[0]; row < last[0]; row++) {
+                for (int32_t col = first[1]; col < last[1]; col++) {
+                    uint32_t sum[3] = {0, 0, 0};
+                    uint32_t alpha = 0;
+                    uint32_t count = 0;
+                    for (int32_t s = 2 * stack; s < std::min(2 * stack + 2, child_size[2]); s++) {
+                        for (int32_t r = 2 * row; r < std::min(2 * row + 2, child_size[0]); r++) {
+                            for (int32_t c = 2 * col; c < std::min(2 * col + 2, child_size[1]); c++) {
+                                auto child = children[CellIndex(child_size, r, c, s)];
+                                for (int i = 0; i < 3; i++) {
+                                    sum[i] += child[i] * child[3];
+                                }
+                                alpha += child[3];
+                                count++;
+                            }
+                        }
+                    }
+                    auto& cell = this->levels[level][CellIndex(cell_size, row, col, stack)];
+                    if (alpha == 0) {
+                        cell = utils::Color{0, 0, 0, 0};
+                        continue;
+                    }
+                    // rounded up, so that a single visible child keeps the cell visible
+                    cell = utils::Color{
+                        static_cast<uint8_t>(sum[0] / alpha),
+                        static_cast<uint8_t>(sum[1] / alpha),
+                        static_cast<uint8_t>(sum[2] / alpha),
+                        static_cast<uint8_t>((alpha + count - 1) / count),
+                    };
+                }
+            }
+        }
+    }
+}
+
+void VoxelPyramid::CollectBrick(const VoxelBuffer& voxels, int32_t brick)
+{
+    auto& state = this->bricks[brick];
+    state.cells.clear();
+    int level = state.level;
+    int32_t scale = 1 << level;
+    const auto& cell_size = this->level_size[level];
+    const utils::Color* colors = level == 0 ? voxels.colors.data() : this->levels[level].data();
+
+    auto [brick_rows, brick_cols, brick_stacks] = this->brick_grid.elements;
+    int32_t begin[3] = {
+        ((brick / brick_cols) % brick_rows) * BRICK,
+        (brick % brick_cols) * BRICK,
+        (brick / (brick_rows * brick_cols)) * BRICK,
+    };
+    int32_t first[3], last[3];
+    for (int axis = 0; axis < 3; axis++) {
+        first[axis] = begin[axis] >> level;
+        last[axis] = std::min((begin[axis] + BRICK) >> level, cell_size[axis]);
+    }
+
+    // a cell of level l covers 2^l voxels, centred between the first and the last one
+    float offset = 0.5f * static_cast<float>(scale - 1);
+    for (int32_t stack = first[2]; stack < last[2]; stack++) {
+        for (int32_t row = first[0]; row < last[0]; row++) {
+            for (int32_t col = first[1]; col < last[1]; col++) {
+                auto color = colors[CellIndex(cell_size, row, col, stack)];
+                if (color[3] == 0) {
+                    continue;
+                }
+                state.cells.push_back(LODCell{
+                    {
+                        static_cast<float>(row * scale) + offset,
+                        static_cast<float>(col * scale) + offset,
+                        static_cast<float>(stack * scale) + offset,
+                    },
+                    static_cast<float>(scale),
+                    color,
+                });
+            }
+        }
+    }
+}
+
+// Coarsest level whose cells still cover at least a pixel at the point of
+// the brick closest to the eye
+int VoxelPyramid::SelectLevel(int32_t brick, const std::array<float, 3>& eye, float pixel_angle) const
+{
+    auto [brick_rows, brick_cols, brick_stacks] = this->brick_grid.elements;
+    int32_t begin[3] = {
+        ((brick / brick_cols) % brick_rows) * BRICK,
+        (brick % brick_cols) * BRICK,
+        (brick / (brick_rows * brick_cols)) * BRICK,
+    };
+    float distance2 = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float low = static_cast<float>(begin[axis]) - 0.5f;
+        float high = static_cast<float>(std::min(begin[axis] + BRICK, this->size[axis])) - 0.5f;
+        float d = eye[axis] - std::clamp(eye[axis], low, high);
+        distance2 += d * d;
+    }
+    // a cell of size 2^level covers about 2^level / (distance * pixel_angle) pixels
+    float pixel = std::sqrt(distance2) * pixel_angle;
+    if (pixel <= 1.0f) {
+        return 0;
+    }
+    return std::min(static_cast<int>(std::ceil(std::log2(pixel))), LEVELS - 1);
+}
+
+utils::Color VoxelPyramid::At(int level, int32_t row, int32_t col, int32_t stack) const
+{
+    return this->levels[level][CellIndex(this->level_size[level], row, col, stack)];
+}
+
+}
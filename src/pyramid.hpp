@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "utilities.hpp"
+#include "voxel.hpp"
+
+namespace UI
+{
+
+// One cube of the level of detail view, drawn as an instance
+struct LODCell {
+    float center[3]; // voxel coordinates
+    float size;      // edge length in voxels, 2^level
+    utils::Color color;
+};
+
+static_assert(sizeof(LODCell) == 20, "LODCell is uploaded to the GPU as is");
+
+/**
+ * Multi-resolution pyramid of a VoxelBuffer, for drawing grids far too
+ * large to draw voxel by voxel.
+ *
+ * Level 0 are the voxels themselves, every further level halves the
+ * resolution: a cell is the average of its (up to) 8 children, colours
+ * weighted by alpha, and stays visible if any of the children is. The
+ * grid is split into bricks of BRICK^3 voxels, so a brick has LEVELS
+ * levels down to a single cell. Only the bricks with changed chunks
+ * (VoxelBuffer::chunk_version) are rebuilt.
+ *
+ * Every brick is drawn at a level picked from its distance to the eye, so
+ * that a cell never covers less than about a pixel: the number of cells
+ * drawn is bounded by the screen resolution rather than by the grid size.
+ * The cells of every brick are kept and only re-collected when the brick
+ * or its level changed.
+ */
+class VoxelPyramid
+{
+public:
+    static constexpr int32_t BRICK = 16;
+    static constexpr int LEVELS = 5; // 16^3, 8^3, 4^3, 2^3 and 1 cell per brick
+
+    // eye in voxel coordinates, pixel_angle is the angle covered by a pixel
+    // (radians), returns true when the cells changed
+    bool Update(const VoxelBuffer& voxels, const std::array<float, 3>& eye, float pixel_angle);
+
+    // Visible cells of all the bricks at their selected levels
+    const std::vector<LODCell>& Cells() const { return this->cells; }
+    // Number of bricks rebuilt by the last Update
+    size_t RebuiltBricks() const { return this->rebuilt; }
+    size_t BrickCount() const { return this->bricks.size(); }
+    int Level(int32_t brick) const { return this->bricks[brick].level; }
+    // Cell of a downsampled level (1 to LEVELS - 1)
+    utils::Color At(int level, int32_t row, int32_t col, int32_t stack) const;
+
+private:
+    struct Brick {
+        int level = -1; // selected, -1 before the first Update
+        std::vector<LODCell> cells;
+    };
+
+    utils::Vec<int32_t, 3> size{0, 0, 0};
+    utils::Vec<int32_t, 3> brick_grid{0, 0, 0}; // number of bricks along each axis
+    // levels[k] has ceil(size / 2^k) cells, level 0 are the voxels (left empty)
+    std::array<std::vector<utils::Color>, LEVELS> levels;
+    std::array<utils::Vec<int32_t, 3>, LEVELS> level_size;
+    std::vector<Brick> bricks;
+    std::vector<LODCell> cells;
+    size_t rebuilt = 0;
+    uint64_t version = 0; // VoxelBuffer::version at the last Update
+
+    void Resize(const utils::Vec<int32_t, 3>& new_size);
+    void BuildBrick(const VoxelBuffer& voxels, int32_t brick);
+    void CollectBrick(const VoxelBuffer& voxels, int32_t brick);
+    int SelectLevel(int32_t brick, const std::array<float, 3>& eye, float pixel_angle) const;
+};
+
+}
@@ -0,0 +1,76 @@
+#include <cassert>
+
+#include "pyramid.hpp"
+#include "log.hpp"
+
+using namespace UI;
+
+const auto red = utils::Color{255, 0, 0, 255};
+const auto blue = utils::Color{0, 0, 255, 255};
+const auto transparent = utils::Color{0, 0, 0, 0};
+
+size_t index(const VoxelBuffer& voxels, int32_t row, int32_t col, int32_t stack)
+{
+    auto [rows, cols, stacks] = voxels.size.elements;
+    return static_cast<size_t>(stack) * rows * cols + row * cols + col;
+}
+
+int main(void)
+{
+    VoxelBuffer voxels;
+    voxels.Resize({40, 40, 40});
+    VoxelPyramid pyramid;
+    constexpr float pixel_angle = 0.001f;
+    const std::array<float, 3> near = {20.0f, 20.0f, 20.0f};
+    const std::array<float, 3> far = {20.0f, 20.0f, 20000.0f};
+
+    // everything invisible, nothing to draw
+    assert(pyramid.Update(voxels, near, pixel_angle));
+    assert(pyramid.BrickCount() == 3 * 3 * 3);
+    assert(pyramid.Cells().empty());
+    assert(!pyramid.Update(voxels, near, pixel_angle));
+
+    // close up every voxel is its own cell
+    voxels.BeginFrame();
+    voxels.SetColor(index(voxels, 20, 20, 20), red);
+    voxels.SetColor(index(voxels, 21, 20, 20), blue);
+    assert(pyramid.Update(voxels, near, pixel_angle));
+    // changes are tracked per chunk, which can span a few bricks
+    Log::debug("rebuilt bricks for two voxels: ", pyramid.RebuiltBricks());
+    assert(pyramid.RebuiltBricks() < pyramid.BrickCount() / 2);
+    assert(pyramid.Cells().size() == 2);
+    assert(pyramid.Cells()[0].size == 1.0f);
+
+    // both end up in the same cell of level 1: mixed colour, still visible
+    auto mixed = pyramid.At(1, 10, 10, 10);
+    assert(mixed[0] == 127 && mixed[2] == 127);
+    assert(mixed[3] != 0 && mixed[3] <= 255 / 4 + 1);
+    for (int level = 2; level < VoxelPyramid::LEVELS; level++) {
+        assert(pyramid.At(level, 20 >> level, 20 >> level, 20 >> level)[3] != 0);
+    }
+
+    // far away the whole brick collapses to a single cell
+    assert(pyramid.Update(voxels, far, pixel_angle));
+    assert(pyramid.RebuiltBricks() == 0);
+    assert(pyramid.Cells().size() == 1);
+    assert(pyramid.Cells()[0].size == float(1 << (VoxelPyramid::LEVELS - 1)));
+
+    // clearing the voxels clears all the levels
+    voxels.BeginFrame();
+    voxels.SetColor(index(voxels, 20, 20, 20), transparent);
+    voxels.SetColor(index(voxels, 21, 20, 20), transparent);
+    assert(pyramid.Update(voxels, far, pixel_angle));
+    assert(pyramid.Cells().empty());
+
+    // dense grid seen from far away: the cell count depends on the distance, not the grid
+    VoxelBuffer large;
+    large.Resize({256, 256, 256});
+    std::fill(large.colors.begin(), large.colors.end(), red);
+    large.MarkAllChanged();
+    VoxelPyramid large_pyramid;
+    large_pyramid.Update(large, {128.0f, 128.0f, 5000.0f}, pixel_angle);
+    Log::debug("256^3 grid far away: ", large.Count(), " voxels, ", large_pyramid.Cells().size(), " cells");
+    assert(large_pyramid.Cells().size() * 256 <= large.Count());
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <cmath>
+#include <algorithm>
+
+#include "raymarcher.hpp"
+
+namespace UI {
+
+namespace {
+
+std::array<float, 3> Normalized(std::array<float, 3> v)
+{
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (auto& x : v) {
+        x /= length;
+    }
+    return v;
+}
+
+std::array<float, 3> Cross(const std::array<float, 3>& a, const std::array<float, 3>& b)
+{
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+// rays stop here, whatever is behind would hardly show anyway
+constexpr float OPAQUE = 0.99f;
+
+}
+
+VolumeRaymarcher::VolumeRaymarcher()
+{
+    // alpha is the opacity of a whole voxel, a step only crosses part of it
+    for (int alpha = 0; alpha < 256; alpha++) {
+        this->opacity[alpha] = 1.0f - std::pow(1.0f - alpha / 255.0f, STEP);
+    }
+}
+
+size_t VolumeRaymarcher::OccupiedBricks() const
+{
+    return std::count(this->occupied.begin(), this->occupied.end(), 1);
+}
+
+void VolumeRaymarcher::UpdateOccupancy(const VoxelBuffer& voxels)
+{
+    bool resized = voxels.size.elements != this->size.elements;
+    if (resized) {
+        this->size = voxels.size;
+        for (int axis = 0; axis < 3; axis++) {
+            this->brick_grid[axis] = (voxels.size[axis] + BRICK - 1) / BRICK;
+        }
+        auto [brick_rows, brick_cols, brick_stacks] = this->brick_grid.elements;
+        this->occupied.assign(static_cast<size_t>(brick_rows) * brick_cols * brick_stacks, 0);
+    }
+
+    // a new simulation starts counting versions again
+    std::vector<uint8_t> dirty(this->occupied.size(), resized || voxels.version < this->version ? 1 : 0);
+    if (!resized && voxels.version > this->version) {
+        voxels.MarkChangedBricks(this->version, BRICK, dirty);
+    }
+    this->version = voxels.version;
+
+    std::vector<int32_t> rebuild;
+    for (size_t brick = 0; brick < dirty.size(); brick++) {
+        if (dirty[brick]) {
+            rebuild.push_back(static_cast<int32_t>(brick));
+        }
+    }
+    auto [rows, cols, stacks] = this->size.elements;
+    auto [brick_rows, brick_cols, brick_stacks] = this->brick_grid.elements;
+    utils::ParallelFor(rebuild.size(), [&](size_t i) {
+        int32_t brick = rebuild[i];
+        int32_t row_begin = ((brick / brick_cols) % brick_rows) * BRICK;
+        int32_t col_begin = (brick % brick_cols) * BRICK;
+        int32_t stack_begin = (brick / (brick_rows * brick_cols)) * BRICK;
+        int32_t row_end = std::min(row_begin + BRICK, rows);
+        int32_t col_end = std::min(col_begin + BRICK, cols);
+        int32_t stack_end = std::min(stack_begin + BRICK, stacks);
+        uint8_t any = 0;
+        for (int32_t stack = stack_begin; stack < stack_end && !any; stack++) {
+            for (int32_t row = row_begin; row < row_end && !any; row++) {
+                size_t index = static_cast<size_t>(stack) * rows * cols + static_cast<size_t>(row) * cols;
+                for (int32_t col = col_begin; col < col_end; col++) {
+                    any |= voxels.colors[index + col][3] != 0;
+                }
+            }
+        }
+        this->occupied[brick] = any;
+    });
+}
+
+void VolumeRaymarcher::Render(const VoxelBuffer& voxels, const View& view, int width, int height,
+                              utils::Color background)
+{
+    UpdateOccupancy(voxels);
+    this->pixels.resize(static_cast<size_t>(width) * height * 4);
+
+    // same camera as gluPerspective + gluLookAt
+    Basis basis;
+    basis.eye = view.eye;
+    basis.forward = Normalized({view.target[0] - view.eye[0], view.target[1] - view.eye[1],
+                                view.target[2] - view.eye[2]});
+    auto right = Normalized(Cross(basis.forward, view.up));
+    auto up = Cross(right, basis.forward);
+    float half_height = std::tan(0.5f * view.fov_y);
+    for (int axis = 0; axis < 3; axis++) {
+        basis.right[axis] = right[axis] * half_height * view.aspect;
+        basis.up[axis] = up[axis] * half_height;
+    }
+
+    int tiles_x = (width + TILE - 1) / TILE;
+    int tiles_y = (height + TILE - 1) / TILE;
+    utils::ParallelFor(static_cast<size_t>(tiles_x) * tiles_y, [&](size_t tile) {
+        RenderTile(voxels, basis, static_cast<int>(tile % tiles_x), static_cast<int>(tile / tiles_x),
+                   width, height, background);
+    });
+}
+
+void VolumeRaymarcher::RenderTile(const VoxelBuffer& voxels, const Basis& basis, int tile_x, int tile_y,
+                                  int width, int height, utils::Color background)
+{
+    // the grid box, voxel i spans i - 0.5 .. i + 0.5
+    float low[3], high[3];
+    for (int axis = 0; axis < 3; axis++) {
+        low[axis] = -0.5f;
+        high[axis] = static_cast<float>(this->size[axis]) - 0.5f;
+    }
+
+    int x_end = std::min((tile_x + 1) * TILE, width);
+    int y_end = std::min((tile_y + 1) * TILE, height);
+    for (int y = tile_y * TILE; y < y_end; y++) {
+        float v = 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(height) - 1.0f;
+        for (int x_begin = tile_x * TILE; x_begin < x_end; x_begin += PACKET) {
+            // set up and clip a packet of rays, lane by lane over plain arrays
+            float direction[3][PACKET];
+            float enter[PACKET], exit[PACKET];
+            for (int lane = 0; lane < PACKET; lane++) {
+                float u = 2.0f * (static_cast<float>(x_begin + lane) + 0.5f) / static_cast<float>(width) - 1.0f;
+                float length2 = 0.0f;
+                for (int axis = 0; axis < 3; axis++) {
+                    direction[axis][lane] = basis.forward[axis] + u * basis.right[axis] + v * basis.up[axis];
+                    length2 += direction[axis][lane] * direction[axis][lane];
+                }
+                float inverse_length = 1.0f / std::sqrt(length2);
+                enter[lane] = 0.0f;
+                exit[lane] = 1e30f;
+                for (int axis = 0; axis < 3; axis++) {
+                    float d = direction[axis][lane] * inverse_length;
+                    // axis parallel rays: a tiny component instead of a division by zero
+                    d = std::fabs(d) < 1e-8f ? 1e-8f : d;
+                    direction[axis][lane] = d;
+                    float t0 = (low[axis] - basis.eye[axis]) / d;
+                    float t1 = (high[axis] - basis.eye[axis]) / d;
+                    enter[lane] = std::max(enter[lane], std::min(t0, t1));
+                    exit[lane] = std::min(exit[lane], std::max(t0, t1));
+                }
+            }
+
+            int lanes = std::min(PACKET, x_end - x_begin);
+            for (int lane = 0; lane < lanes; lane++) {
+                std::array<float, 4> color = {0.0f, 0.0f, 0.0f, 0.0f};
+                if (enter[lane] < exit[lane]) {
+                    Ray ray{basis.eye, {direction[0][lane], direction[1][lane], direction[2][lane]},
+                            enter[lane], exit[lane]};
+                    color = March(voxels, ray);
+                }
+                uint8_t* pixel = &this->pixels[(static_cast<size_t>(y) * width + x_begin + lane) * 4];
+                for (int i = 0; i < 3; i++) {
+                    float value = color[i] + (1.0f - color[3]) * background[i];
+                    pixel[i] = static_cast<uint8_t>(std::min(value + 0.5f, 255.0f));
+                }
+                pixel[3] = 255;
+            }
+        }
+    }
+}
+
+// Front to back compositing, colour premultiplied by alpha, 0..255
+std::array<float, 4> VolumeRaymarcher::March(const VoxelBuffer& voxels, const Ray& ray) const
+{
+    auto [rows, cols, stacks] = this->size.elements;
+    auto [brick_rows, brick_cols, brick_stacks] = this->brick_grid.elements;
+    std::array<float, 4> color = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    // voxel i spans i - 0.5 .. i + 0.5, shifted by half a voxel the rounding
+    // is a truncation (negative values only occur right at the border)
+    float shifted[3];
+    for (int axis = 0; axis < 3; axis++) {
+        shifted[axis] = ray.origin[axis] + 0.5f;
+    }
+
+    float t = ray.enter;
+    while (t < ray.exit && color[3] < OPAQUE) {
+        int32_t voxel[3];
+        for (int axis = 0; axis < 3; axis++) {
+            auto rounded = static_cast<int32_t>(shifted[axis] + ray.direction[axis] * t);
+            voxel[axis] = std::clamp(rounded, 0, this->size[axis] - 1);
+        }
+        size_t brick = static_cast<size_t>(voxel[2] / BRICK) * brick_rows * brick_cols +
+                       static_cast<size_t>(voxel[0] / BRICK) * brick_cols + voxel[1] / BRICK;
+        if (!this->occupied[brick]) {
+            // skip to where the ray leaves the brick, staying on the grid of steps
+            float leave = ray.exit;
+            for (int axis = 0; axis < 3; axis++) {
+                int32_t first = voxel[axis] / BRICK * BRICK;
+                float bound = ray.direction[axis] > 0.0f ? static_cast<float>(first + BRICK) - 0.5f
+                                                         : static_cast<float>(first) - 0.5f;
+                leave = std::min(leave, (bound - ray.origin[axis]) / ray.direction[axis]);
+            }
+            t += std::max(std::ceil((leave - t) / STEP), 1.0f) * STEP;
+            continue;
+        }
+
+        size_t index = static_cast<size_t>(voxel[2]) * rows * cols + static_cast<size_t>(voxel[0]) * cols + voxel[1];
+        const auto& sample = voxels.colors[index];
+        float weight = (1.0f - color[3]) * this->opacity[sample[3]];
+        for (int i = 0; i < 3; i++) {
+            color[i] += weight * sample[i];
+        }
+        color[3] += weight;
+        t += STEP;
+    }
+    return color;
+}
+
+}
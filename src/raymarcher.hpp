@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "utilities.hpp"
+#include "voxel.hpp"
+
+namespace UI
+{
+
+/**
+ * Volume rendering on the CPU: a ray per pixel is marched through the grid
+ * and the voxel colours are composited front to back, the alpha of a voxel
+ * being its opacity per voxel of distance travelled. Looks better than
+ * blending millions of cubes for dense fields and needs no GPU, the caller
+ * only blits the image (or writes it out when headless).
+ *
+ * Empty space is skipped with the occupancy of bricks of BRICK^3 voxels,
+ * updated from the changed chunks only, and rays stop once nearly opaque.
+ * The image is split into tiles of TILE^2 pixels handed out to worker
+ * threads, the rays of a tile are set up and clipped to the grid in packets
+ * of PACKET with plain loops over arrays, which the compiler vectorizes.
+ * Marching itself is per ray, the rays of a packet diverge too quickly
+ * (skipped bricks, early termination) to gain from running in lockstep.
+ */
+class VolumeRaymarcher
+{
+public:
+    static constexpr int32_t BRICK = 8;
+    static constexpr int TILE = 32;
+    static constexpr int PACKET = 8;
+    static constexpr float STEP = 0.5f; // in voxels
+
+    // Perspective camera, everything in voxel coordinates
+    struct View {
+        std::array<float, 3> eye;
+        std::array<float, 3> target;
+        std::array<float, 3> up;
+        float fov_y;  // radians
+        float aspect; // width / height
+    };
+
+    VolumeRaymarcher();
+
+    void Render(const VoxelBuffer& voxels, const View& view, int width, int height, utils::Color background);
+
+    // RGBA, bottom row first (the glDrawPixels / glReadPixels layout)
+    const std::vector<uint8_t>& Pixels() const { return this->pixels; }
+    size_t OccupiedBricks() const;
+
+private:
+    // direction of the ray through (u, v) in -1..1 is forward + u * right + v * up
+    struct Basis {
+        std::array<float, 3> eye, forward, right, up;
+    };
+    struct Ray {
+        std::array<float, 3> origin;
+        std::array<float, 3> direction;
+        float enter, exit; // part of the ray inside the grid
+    };
+
+    std::vector<uint8_t> pixels;
+    std::array<float, 256> opacity; // alpha of a voxel -> opacity of a STEP
+
+    utils::Vec<int32_t, 3> size{0, 0, 0};
+    utils::Vec<int32_t, 3> brick_grid{0, 0, 0};
+    std::vector<uint8_t> occupied; // per brick, any voxel with alpha != 0
+    uint64_t version = 0;          // VoxelBuffer::version of the occupancy
+
+    void UpdateOccupancy(const VoxelBuffer& voxels);
+    void RenderTile(const VoxelBuffer& voxels, const Basis& basis, int tile_x, int tile_y,
+                    int width, int height, utils::Color background);
+    std::array<float, 4> March(const VoxelBuffer& voxels, const Ray& ray) const;
+};
+
+}
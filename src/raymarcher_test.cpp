@@ -0,0 +1,71 @@
+#include <cmath>
+#include <cassert>
+
+#include "raymarcher.hpp"
+#include "log.hpp"
+
+using namespace UI;
+
+const auto red = utils::Color{255, 0, 0, 255};
+const auto background = utils::Color{0, 0, 50, 255};
+
+size_t index(const VoxelBuffer& voxels, int32_t row, int32_t col, int32_t stack)
+{
+    auto [rows, cols, stacks] = voxels.size.elements;
+    return static_cast<size_t>(stack) * rows * cols + row * cols + col;
+}
+
+const uint8_t* pixel(const VolumeRaymarcher& raymarcher, int width, int x, int y)
+{
+    return &raymarcher.Pixels()[(static_cast<size_t>(y) * width + x) * 4];
+}
+
+int main(void)
+{
+    constexpr int width = 64, height = 48;
+    VoxelBuffer voxels;
+    voxels.Resize({32, 32, 32});
+    VolumeRaymarcher raymarcher;
+    // looking down the stacks at the middle of the grid
+    VolumeRaymarcher::View view{{15.5f, 15.5f, 100.0f}, {15.5f, 15.5f, 0.0f}, {1.0f, 0.0f, 0.0f},
+                                static_cast<float>(M_PI / 4), float(width) / height};
+
+    // empty grid, nothing but background
+    raymarcher.Render(voxels, view, width, height, background);
+    assert(raymarcher.OccupiedBricks() == 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            auto p = pixel(raymarcher, width, x, y);
+            assert(p[0] == 0 && p[1] == 0 && p[2] == 50 && p[3] == 255);
+        }
+    }
+
+    // an opaque block in the middle covers the centre of the image, only its brick is occupied
+    voxels.BeginFrame();
+    for (int32_t stack = 8; stack < 16; stack++) {
+        for (int32_t row = 14; row < 18; row++) {
+            for (int32_t col = 14; col < 18; col++) {
+                voxels.SetColor(index(voxels, row, col, stack), red);
+            }
+        }
+    }
+    raymarcher.Render(voxels, view, width, height, background);
+    Log::debug("occupied bricks: ", raymarcher.OccupiedBricks());
+    assert(raymarcher.OccupiedBricks() == 4);
+    auto centre = pixel(raymarcher, width, width / 2, height / 2);
+    assert(centre[0] > 250 && centre[2] < 5);
+    auto corner = pixel(raymarcher, width, 0, 0);
+    assert(corner[0] == 0 && corner[2] == 50);
+
+    // half transparent: some of the background shows through
+    voxels.BeginFrame();
+    for (uint32_t i = 0; i < voxels.Count(); i++) {
+        voxels.SetColor(i, voxels.colors[i][3] != 0 ? utils::Color{255, 0, 0, 20} : voxels.colors[i]);
+    }
+    raymarcher.Render(voxels, view, width, height, background);
+    centre = pixel(raymarcher, width, width / 2, height / 2);
+    Log::debug("translucent centre: ", int(centre[0]), " ", int(centre[1]), " ", int(centre[2]));
+    assert(centre[0] > 100 && centre[0] < 250 && centre[2] > 0);
+
+    return 0;
+}
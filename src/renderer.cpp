@@ -0,0 +1,631 @@
+#include <array>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+#include "log.hpp"
+#include "renderer.hpp"
+
+namespace UI {
+
+namespace {
+
+enum Attribute : GLuint {
+    POSITION = 0,
+    NORMAL = 1,
+    INDEX = 2,
+    COLOR = 3,
+    CELL = 4,
+};
+
+// prepended to all the shaders
+const char* SHADER_HEADER = R"(#version 140
+
+// directional light from the same direction as in enable_light()
+const vec3 LIGHT_DIR = vec3(0.57735, 0.57735, 0.57735);
+const float AMBIENT = 0.2;
+
+// half-Lambert, so that faces turned away from the light are not black
+vec3 Shade(vec3 color, vec3 normal)
+{
+    float diffuse = 0.5 + 0.5 * dot(normal, LIGHT_DIR);
+    return color * (AMBIENT + (1.0 - AMBIENT) * diffuse);
+}
+)";
+
+const char* VERTEX_SHADER = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+uniform ivec3 u_grid; // rows, cols, stacks
+uniform vec3 u_eye;   // camera position in voxel coordinates
+uniform samplerBuffer u_colors; // VoxelBuffer::colors
+
+in vec3 a_position;
+in vec3 a_normal;
+in uint a_index; // per instance, from VoxelBuffer::visible
+
+out vec4 v_color;
+
+void main()
+{
+    // index = stack * (rows * cols) + row * cols + col, see VoxelBuffer
+    int index = int(a_index);
+    int plane = u_grid.x * u_grid.y;
+    int in_plane = index % plane;
+    vec3 voxel = vec3(in_plane / u_grid.y, in_plane % u_grid.y, index / plane);
+    vec4 color = texelFetch(u_colors, index);
+
+    // flip the faces to the side of the cube facing the eye
+    vec3 side = 2.0 * step(voxel, u_eye) - 1.0;
+    v_color = vec4(Shade(color.rgb, a_normal * side), color.a);
+    gl_Position = u_projection * u_modelview * vec4(a_position * side + voxel, 1.0);
+}
+)";
+
+// cells of a VoxelPyramid, a cube each, per instance data instead of a texture buffer
+const char* LOD_VERTEX_SHADER = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+uniform vec3 u_eye; // camera position in voxel coordinates
+
+in vec3 a_position;
+in vec3 a_normal;
+in vec4 a_cell;  // per instance, center and size, see LODCell
+in vec4 a_color; // per instance
+
+out vec4 v_color;
+
+void main()
+{
+    vec3 side = 2.0 * step(a_cell.xyz, u_eye) - 1.0;
+    v_color = vec4(Shade(a_color.rgb, a_normal * side), a_color.a);
+    gl_Position = u_projection * u_modelview * vec4(a_position * side * a_cell.w + a_cell.xyz, 1.0);
+}
+)";
+
+// greedy mesh from VoxelMesher, drawn opaque
+const char* MESH_VERTEX_SHADER = R"(
+uniform mat4 u_projection;
+uniform mat4 u_modelview;
+
+in vec3 a_position;
+in vec3 a_normal;
+in vec4 a_color;
+
+out vec4 v_color;
+
+void main()
+{
+    v_color = vec4(Shade(a_color.rgb, a_normal), 1.0);
+    gl_Position = u_projection * u_modelview * vec4(a_position, 1.0);
+}
+)";
+
+const char* FRAGMENT_SHADER = R"(
+in vec4 v_color;
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = v_color;
+}
+)";
+
+// position and normal of the +x, +y and +z faces, the vertex shader mirrors
+// them towards the eye (the other three faces of a cube are never visible)
+const GLfloat CUBE_VERTICES[] = {
+    // (1,0,0)
+     0.5f, -0.5f, -0.5f,    1.0f,  0.0f,  0.0f,
+     0.5f,  0.5f, -0.5f,    1.0f,  0.0f,  0.0f,
+     0.5f,  0.5f,  0.5f,    1.0f,  0.0f,  0.0f,
+     0.5f, -0.5f,  0.5f,    1.0f,  0.0f,  0.0f,
+    // (0,1,0)
+    -0.5f,  0.5f, -0.5f,    0.0f,  1.0f,  0.0f,
+    -0.5f,  0.5f,  0.5f,    0.0f,  1.0f,  0.0f,
+     0.5f,  0.5f,  0.5f,    0.0f,  1.0f,  0.0f,
+     0.5f,  0.5f, -0.5f,    0.0f,  1.0f,  0.0f,
+    // (0,0,1)
+    -0.5f, -0.5f,  0.5f,    0.0f,  0.0f,  1.0f,
+     0.5f, -0.5f,  0.5f,    0.0f,  0.0f,  1.0f,
+     0.5f,  0.5f,  0.5f,    0.0f,  0.0f,  1.0f,
+    -0.5f,  0.5f,  0.5f,    0.0f,  0.0f,  1.0f,
+};
+
+const GLushort CUBE_INDICES[] = {
+     0,  1,  2,     2,  3,  0,
+     4,  5,  6,     6,  7,  4,
+     8,  9, 10,    10, 11,  8,
+};
+
+GLuint CompileShader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    const char* sources[] = {SHADER_HEADER, source};
+    glShaderSource(shader, 2, sources, nullptr);
+    glCompileShader(shader);
+
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::string info(length, '\0');
+        glGetShaderInfoLog(shader, length, nullptr, info.data());
+        Log::error("Shader compilation failed: ", info);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint LinkProgram(const char* vertex_source)
+{
+    GLuint vertex = CompileShader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment = CompileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+    if (vertex == 0 || fragment == 0) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glBindAttribLocation(program, POSITION, "a_position");
+    glBindAttribLocation(program, NORMAL, "a_normal");
+    glBindAttribLocation(program, INDEX, "a_index");
+    glBindAttribLocation(program, COLOR, "a_color");
+    glBindAttribLocation(program, CELL, "a_cell");
+    glBindFragDataLocation(program, 0, "frag_color");
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::string info(length, '\0');
+        glGetProgramInfoLog(program, length, nullptr, info.data());
+        Log::error("Shader program linking failed: ", info);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// eye = -R^T * t, the modelview has no scaling
+std::array<GLfloat, 3> EyeFromModelview(const GLfloat* modelview)
+{
+    std::array<GLfloat, 3> eye;
+    for (int axis = 0; axis < 3; axis++) {
+        eye[axis] = -(modelview[axis * 4 + 0] * modelview[12] +
+                      modelview[axis * 4 + 1] * modelview[13] +
+                      modelview[axis * 4 + 2] * modelview[14]);
+    }
+    return eye;
+}
+
+}
+
+VoxelRenderer::~VoxelRenderer()
+{
+    Release();
+}
+
+bool VoxelRenderer::Init()
+{
+    Log::info("OpenGL ", reinterpret_cast<const char*>(glGetString(GL_VERSION)),
+              ", renderer ", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+    if (!GLEW_VERSION_3_1 || !(GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays)) {
+        Log::warning("Instanced rendering not supported, falling back to drawing cubes one by one");
+        return false;
+    }
+    this->divisor_arb = !GLEW_VERSION_3_3;
+
+    if (!CreatePrograms()) {
+        Log::warning("Falling back to drawing cubes one by one");
+        return false;
+    }
+
+    glGenVertexArrays(1, &this->vao);
+    glBindVertexArray(this->vao);
+
+    glGenBuffers(1, &this->cube_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, this->cube_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_VERTICES), CUBE_VERTICES, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(POSITION);
+    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), nullptr);
+    glEnableVertexAttribArray(NORMAL);
+    glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat),
+                          reinterpret_cast<const void*>(3 * sizeof(GLfloat)));
+
+    glGenBuffers(1, &this->cube_ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->cube_ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CUBE_INDICES), CUBE_INDICES, GL_STATIC_DRAW);
+
+    // voxel index per instance, the storage is allocated on the first Draw
+    glGenBuffers(1, &this->index_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, this->index_vbo);
+    glEnableVertexAttribArray(INDEX);
+    glVertexAttribIPointer(INDEX, 1, GL_UNSIGNED_INT, sizeof(uint32_t), nullptr);
+    SetDivisor(INDEX);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // colours of the whole grid, fetched by index in the vertex shader
+    glGenBuffers(1, &this->color_vbo);
+    glBindBuffer(GL_TEXTURE_BUFFER, this->color_vbo);
+    glGenTextures(1, &this->color_tex);
+    glBindTexture(GL_TEXTURE_BUFFER, this->color_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, this->color_vbo);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // greedy mesh, uploaded whenever it changes
+    glGenVertexArrays(1, &this->mesh_vao);
+    glBindVertexArray(this->mesh_vao);
+    glGenBuffers(1, &this->mesh_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, this->mesh_vbo);
+    glEnableVertexAttribArray(POSITION);
+    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                          reinterpret_cast<const void*>(offsetof(MeshVertex, position)));
+    glEnableVertexAttribArray(NORMAL);
+    glVertexAttribPointer(NORMAL, 3, GL_BYTE, GL_TRUE, sizeof(MeshVertex),
+                          reinterpret_cast<const void*>(offsetof(MeshVertex, normal)));
+    glEnableVertexAttribArray(COLOR);
+    glVertexAttribPointer(COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(MeshVertex),
+                          reinterpret_cast<const void*>(offsetof(MeshVertex, color)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // level of detail cells, same cube as the instanced voxels
+    glGenVertexArrays(1, &this->lod_vao);
+    glBindVertexArray(this->lod_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, this->cube_vbo);
+    glEnableVertexAttribArray(POSITION);
+    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), nullptr);
+    glEnableVertexAttribArray(NORMAL);
+    glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat),
+                          reinterpret_cast<const void*>(3 * sizeof(GLfloat)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->cube_ibo);
+    glGenBuffers(1, &this->lod_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, this->lod_vbo);
+    glEnableVertexAttribArray(CELL);
+    glVertexAttribPointer(CELL, 4, GL_FLOAT, GL_FALSE, sizeof(LODCell),
+                          reinterpret_cast<const void*>(offsetof(LODCell, center)));
+    SetDivisor(CELL);
+    glEnableVertexAttribArray(COLOR);
+    glVertexAttribPointer(COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LODCell),
+                          reinterpret_cast<const void*>(offsetof(LODCell, color)));
+    SetDivisor(COLOR);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLint max_texels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+    this->max_colors = static_cast<size_t>(max_texels);
+
+    Log::info("Using instanced voxel rendering");
+    return true;
+}
+
+bool VoxelRenderer::CreatePrograms()
+{
+    GLuint program = LinkProgram(VERTEX_SHADER);
+    GLuint mesh_program = LinkProgram(MESH_VERTEX_SHADER);
+    GLuint lod_program = LinkProgram(LOD_VERTEX_SHADER);
+    if (program == 0 || mesh_program == 0 || lod_program == 0) {
+        glDeleteProgram(program);
+        glDeleteProgram(mesh_program);
+        glDeleteProgram(lod_program);
+        return false;
+    }
+
+    this->program = program;
+    this->u_projection = glGetUniformLocation(program, "u_projection");
+    this->u_modelview = glGetUniformLocation(program, "u_modelview");
+    this->u_grid = glGetUniformLocation(program, "u_grid");
+    this->u_eye = glGetUniformLocation(program, "u_eye");
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "u_colors"), 0);
+    glUseProgram(0);
+
+    this->mesh_program = mesh_program;
+    this->mesh_u_projection = glGetUniformLocation(mesh_program, "u_projection");
+    this->mesh_u_modelview = glGetUniformLocation(mesh_program, "u_modelview");
+
+    this->lod_program = lod_program;
+    this->lod_u_projection = glGetUniformLocation(lod_program, "u_projection");
+    this->lod_u_modelview = glGetUniformLocation(lod_program, "u_modelview");
+    this->lod_u_eye = glGetUniformLocation(lod_program, "u_eye");
+    return true;
+}
+
+// per instance attribute
+void VoxelRenderer::SetDivisor(unsigned int attribute)
+{
+    if (this->divisor_arb) {
+        glVertexAttribDivisorARB(attribute, 1);
+    } else {
+        glVertexAttribDivisor(attribute, 1);
+    }
+}
+
+void VoxelRenderer::Release()
+{
+    if (this->program == 0) {
+        return;
+    }
+    glDeleteBuffers(1, &this->mesh_vbo);
+    glDeleteVertexArrays(1, &this->mesh_vao);
+    glDeleteProgram(this->mesh_program);
+    this->mesh_program = this->mesh_vao = this->mesh_vbo = 0;
+    this->mesh_vertices = 0;
+    this->mesher = VoxelMesher{};
+
+    glDeleteBuffers(1, &this->lod_vbo);
+    glDeleteVertexArrays(1, &this->lod_vao);
+    glDeleteProgram(this->lod_program);
+    this->lod_program = this->lod_vao = this->lod_vbo = 0;
+    this->lod_cells = 0;
+    this->pyramid = VoxelPyramid{};
+
+    glDeleteTextures(1, &this->color_tex);
+    glDeleteBuffers(1, &this->color_vbo);
+    glDeleteBuffers(1, &this->index_vbo);
+    glDeleteBuffers(1, &this->cube_ibo);
+    glDeleteBuffers(1, &this->cube_vbo);
+    glDeleteVertexArrays(1, &this->vao);
+    glDeleteProgram(this->program);
+    this->program = this->vao = this->cube_vbo = this->cube_ibo = 0;
+    this->index_vbo = this->color_vbo = this->color_tex = 0;
+    this->color_capacity = this->index_capacity = 0;
+    this->too_large = false;
+    this->order = BackToFrontOrder{};
+}
+
+void VoxelRenderer::UploadColors(const VoxelBuffer& voxels)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, this->color_vbo);
+    auto bytes = static_cast<GLsizeiptr>(voxels.Count() * sizeof(utils::Color));
+    if (voxels.Count() != this->color_capacity) {
+        glBufferData(GL_TEXTURE_BUFFER, bytes, voxels.Data(), GL_DYNAMIC_DRAW);
+        this->color_capacity = voxels.Count();
+    } else if (voxels.version != this->color_version) {
+        size_t changed = 0;
+        voxels.ForEachChangedRange(this->color_version, [&](size_t begin, size_t end) {
+            changed += end - begin;
+        });
+        // one large upload beats many small ones when a lot has changed
+        if (changed > voxels.Count() / 4) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, voxels.Data());
+        } else {
+            voxels.ForEachChangedRange(this->color_version, [&](size_t begin, size_t end) {
+                glBufferSubData(GL_TEXTURE_BUFFER, begin * sizeof(utils::Color),
+                                (end - begin) * sizeof(utils::Color), &voxels.colors[begin]);
+            });
+        }
+    }
+    this->color_version = voxels.version;
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void VoxelRenderer::UploadVisible(const VoxelBuffer& voxels, const std::vector<uint32_t>& indices)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, this->index_vbo);
+    auto bytes = static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t));
+    if (indices.size() > this->index_capacity) {
+        // the whole grid, so that it is allocated only once
+        this->index_capacity = voxels.Count();
+        glBufferData(GL_ARRAY_BUFFER, this->index_capacity * sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, indices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool VoxelRenderer::Draw(const VoxelBuffer& voxels)
+{
+    if (voxels.Count() > this->max_colors) {
+        if (!this->too_large) {
+            Log::warning("Grid of ", voxels.Count(), " voxels is too large for a texture buffer (max ",
+                         this->max_colors, "), drawing cubes one by one unless LOD is on");
+            this->too_large = true;
+        }
+        return false;
+    }
+    if (voxels.visible.empty()) {
+        return true;
+    }
+    UploadColors(voxels);
+
+    GLfloat projection[16];
+    GLfloat modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    auto eye = EyeFromModelview(modelview);
+
+    // blending needs the voxels back to front, the order only changes
+    // with the voxels or when the eye crosses into another slab
+    if (this->order.Update(voxels, eye)) {
+        UploadVisible(voxels, this->order.Indices());
+    }
+
+    glUseProgram(this->program);
+    glUniformMatrix4fv(this->u_projection, 1, GL_FALSE, projection);
+    glUniformMatrix4fv(this->u_modelview, 1, GL_FALSE, modelview);
+    auto [rows, cols, stacks] = voxels.size.elements;
+    glUniform3i(this->u_grid, rows, cols, stacks);
+    glUniform3fv(this->u_eye, 1, eye.data());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, this->color_tex);
+
+    glBindVertexArray(this->vao);
+    glDrawElementsInstanced(GL_TRIANGLES, sizeof(CUBE_INDICES) / sizeof(CUBE_INDICES[0]),
+                            GL_UNSIGNED_SHORT, nullptr, static_cast<GLsizei>(this->order.Indices().size()));
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glUseProgram(0);
+    return true;
+}
+
+void VoxelRenderer::DrawMesh(const VoxelBuffer& voxels)
+{
+    if (this->mesher.Update(voxels)) {
+        const auto& vertices = this->mesher.Vertices();
+        glBindBuffer(GL_ARRAY_BUFFER, this->mesh_vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        this->mesh_vertices = vertices.size();
+    }
+    if (this->mesh_vertices == 0) {
+        return;
+    }
+
+    GLfloat projection[16];
+    GLfloat modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+
+    glUseProgram(this->mesh_program);
+    glUniformMatrix4fv(this->mesh_u_projection, 1, GL_FALSE, projection);
+    glUniformMatrix4fv(this->mesh_u_modelview, 1, GL_FALSE, modelview);
+
+    glBindVertexArray(this->mesh_vao);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(this->mesh_vertices));
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void VoxelRenderer::DrawLOD(const VoxelBuffer& voxels, float pixel_angle)
+{
+    GLfloat projection[16];
+    GLfloat modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    auto eye = EyeFromModelview(modelview);
+
+    if (this->pyramid.Update(voxels, eye, pixel_angle)) {
+        const auto& cells = this->pyramid.Cells();
+        glBindBuffer(GL_ARRAY_BUFFER, this->lod_vbo);
+        glBufferData(GL_ARRAY_BUFFER, cells.size() * sizeof(LODCell), cells.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        this->lod_cells = cells.size();
+    }
+    if (this->lod_cells == 0) {
+        return;
+    }
+
+    glUseProgram(this->lod_program);
+    glUniformMatrix4fv(this->lod_u_projection, 1, GL_FALSE, projection);
+    glUniformMatrix4fv(this->lod_u_modelview, 1, GL_FALSE, modelview);
+    glUniform3fv(this->lod_u_eye, 1, eye.data());
+
+    glBindVertexArray(this->lod_vao);
+    glDrawElementsInstanced(GL_TRIANGLES, sizeof(CUBE_INDICES) / sizeof(CUBE_INDICES[0]),
+                            GL_UNSIGNED_SHORT, nullptr, static_cast<GLsizei>(this->lod_cells));
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+SliceRenderer::~SliceRenderer()
+{
+    Release();
+}
+
+void SliceRenderer::Release()
+{
+    for (auto& plane : this->planes) {
+        if (plane.texture != 0) {
+            glDeleteTextures(1, &plane.texture);
+        }
+        plane = Plane{};
+    }
+}
+
+// The plane perpendicular to axis has the next axis along its width and
+// the one after along its height, texel (u, v) is voxel coords[axis] = index,
+// coords[(axis + 1) % 3] = u, coords[(axis + 2) % 3] = v
+void SliceRenderer::Upload(const VoxelBuffer& voxels, int axis, int32_t index)
+{
+    auto& plane = this->planes[axis];
+    auto [rows, cols, stacks] = voxels.size.elements;
+    int u_axis = (axis + 1) % 3;
+    int v_axis = (axis + 2) % 3;
+    int32_t width = voxels.size[u_axis];
+    int32_t height = voxels.size[v_axis];
+
+    size_t plane_size = static_cast<size_t>(rows) * cols;
+    size_t strides[3] = {static_cast<size_t>(cols), 1, plane_size}; // row, col, stack
+    this->texels.resize(static_cast<size_t>(width) * height);
+    size_t base = strides[axis] * index;
+    for (int32_t v = 0; v < height; v++) {
+        for (int32_t u = 0; u < width; u++) {
+            this->texels[static_cast<size_t>(v) * width + u] =
+                voxels.colors[base + strides[u_axis] * u + strides[v_axis] * v];
+        }
+    }
+
+    if (plane.texture == 0) {
+        glGenTextures(1, &plane.texture);
+    }
+    glBindTexture(GL_TEXTURE_2D, plane.texture);
+    if (plane.width != width || plane.height != height) {
+        // voxels are cubes, no filtering between them
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, this->texels.data());
+        plane.width = width;
+        plane.height = height;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, this->texels.data());
+    }
+    plane.index = index;
+    plane.version = voxels.version;
+}
+
+void SliceRenderer::Draw(const VoxelBuffer& voxels, const Simulation::Slices& slices)
+{
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+    for (int axis = 0; axis < 3; axis++) {
+        int32_t index = slices.index[axis];
+        if (index < 0 || index >= voxels.size[axis]) {
+            continue;
+        }
+        auto& plane = this->planes[axis];
+        if (plane.index != index || plane.version != voxels.version) {
+            Upload(voxels, axis, index);
+        }
+
+        // quad covering the voxel faces, centred on the voxels of the plane
+        glBindTexture(GL_TEXTURE_2D, plane.texture);
+        float corner_u[4] = {0, 1, 1, 0};
+        float corner_v[4] = {0, 0, 1, 1};
+        glBegin(GL_QUADS);
+        for (int c = 0; c < 4; c++) {
+            float position[3];
+            position[axis] = static_cast<float>(index);
+            position[(axis + 1) % 3] = corner_u[c] * plane.width - 0.5f;
+            position[(axis + 2) % 3] = corner_v[c] * plane.height - 0.5f;
+            glTexCoord2f(corner_u[c], corner_v[c]);
+            glVertex3fv(position);
+        }
+        glEnd();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+}
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "voxel.hpp"
+#include "mesher.hpp"
+#include "pyramid.hpp"
+#include "draw_order.hpp"
+#include "simulations/base.hpp"
+
+namespace UI
+{
+
+/**
+ * Draws a whole VoxelBuffer with a single instanced draw call.
+ *
+ * The cube geometry lives in a vertex buffer uploaded once. Only the
+ * visible voxels (VoxelBuffer::visible) are drawn, the per-instance data
+ * is just the voxel index. The vertex shader computes the position from
+ * the index (same layout as VoxelBuffer) and fetches the colour from a
+ * texture buffer holding the whole grid, of which only the chunks changed
+ * since the last frame are re-uploaded. Only the three faces turned towards
+ * the camera are drawn, and the voxels go back to front (BackToFrontOrder),
+ * so that blending is correct without sorting. Projection and modelview are
+ * taken from the fixed function matrix stacks, so the Camera works unchanged.
+ *
+ * With alpha off DrawMesh() can be used instead, it draws the surface
+ * mesh built by VoxelMesher (only the outer faces, merged into quads).
+ * For very large grids DrawLOD() draws the cells of a VoxelPyramid, coarser
+ * the further away they are, as instances carrying position and colour
+ * (no texture buffer, so the grid size isn't limited by it).
+ *
+ * Needs OpenGL 3.1 (texture buffers) and instanced arrays (3.3 or ARB_instanced_arrays),
+ * Mesa's llvmpipe provides both. When they are missing Init() returns
+ * false and the caller should fall back to draw_cube.
+ */
+class VoxelRenderer
+{
+public:
+    VoxelRenderer() = default;
+    ~VoxelRenderer();
+
+    VoxelRenderer(const VoxelRenderer&) = delete;
+    VoxelRenderer& operator=(const VoxelRenderer&) = delete;
+
+    // Has to be called with a current GL context (after glewInit)
+    bool Init();
+    // Frees the GL objects, has to be called before the context is destroyed
+    void Release();
+    bool Available() const { return this->program != 0; }
+
+    // Instanced cubes, respects the alpha of the voxels. False (and nothing
+    // drawn) when the grid doesn't fit a texture buffer, the other draws
+    // still work then
+    bool Draw(const VoxelBuffer& voxels);
+    // Opaque surface mesh, re-meshes only the bricks that changed
+    void DrawMesh(const VoxelBuffer& voxels);
+    // Level of detail cubes, pixel_angle is the angle covered by a pixel
+    // (radians), respects the alpha of the voxels
+    void DrawLOD(const VoxelBuffer& voxels, float pixel_angle);
+
+private:
+    // GL object names, kept as plain unsigned ints so that this header
+    // doesn't need the GL headers
+    unsigned int program = 0;
+    unsigned int vao = 0;
+    unsigned int cube_vbo = 0;
+    unsigned int cube_ibo = 0;
+    unsigned int index_vbo = 0;
+    unsigned int color_vbo = 0;
+    unsigned int color_tex = 0;
+    size_t index_capacity = 0; // in voxels
+    size_t color_capacity = 0; // in voxels
+    uint64_t color_version = 0; // VoxelBuffer::version of the uploaded colours
+    size_t max_colors = 0;     // texture buffer size limit
+    bool too_large = false;    // warned about a grid over max_colors
+    bool divisor_arb = false;  // only the ARB entry point is available
+    BackToFrontOrder order;    // of the uploaded indices
+
+    int u_projection = -1;
+    int u_modelview = -1;
+    int u_grid = -1;
+    int u_eye = -1;
+
+    unsigned int mesh_program = 0;
+    unsigned int mesh_vao = 0;
+    unsigned int mesh_vbo = 0;
+    size_t mesh_vertices = 0;
+    int mesh_u_projection = -1;
+    int mesh_u_modelview = -1;
+    VoxelMesher mesher;
+
+    unsigned int lod_program = 0;
+    unsigned int lod_vao = 0;
+    unsigned int lod_vbo = 0;
+    size_t lod_cells = 0;
+    int lod_u_projection = -1;
+    int lod_u_modelview = -1;
+    int lod_u_eye = -1;
+    VoxelPyramid pyramid;
+
+    bool CreatePrograms();
+    void SetDivisor(unsigned int attribute);
+    void UploadColors(const VoxelBuffer& voxels);
+    void UploadVisible(const VoxelBuffer& voxels, const std::vector<uint32_t>& indices);
+};
+
+/**
+ * Slice view: the selected planes of the grid (Simulation::Slices) drawn
+ * as textured quads, one texel per voxel, instead of the whole cube cloud.
+ *
+ * A plane texture is only re-uploaded when the voxels or the plane index
+ * changed. Uses the fixed function pipeline and non power of two textures
+ * (OpenGL 2.0), so it works where VoxelRenderer doesn't.
+ */
+class SliceRenderer
+{
+public:
+    SliceRenderer() = default;
+    ~SliceRenderer();
+
+    SliceRenderer(const SliceRenderer&) = delete;
+    SliceRenderer& operator=(const SliceRenderer&) = delete;
+
+    // Frees the textures, has to be called before the context is destroyed
+    void Release();
+    void Draw(const VoxelBuffer& voxels, const Simulation::Slices& slices);
+
+private:
+    struct Plane {
+        unsigned int texture = 0;
+        int32_t index = -1;    // plane in the texture
+        uint64_t version = 0;  // VoxelBuffer::version of the texture
+        int32_t width = 0, height = 0;
+    };
+    std::array<Plane, 3> planes; // per axis perpendicular to the plane
+    std::vector<utils::Color> texels;
+
+    void Upload(const VoxelBuffer& voxels, int axis, int32_t index);
+};
+
+}
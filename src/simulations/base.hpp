@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <string>
 #include <vector>
 #include <cstdint>
 
@@ -8,6 +10,15 @@
 
 namespace Simulation {
 
+// Axis aligned planes of the grid shown by the slice view,
+// index[axis] is the row / col / stack of the plane, -1 when off
+struct Slices {
+    bool enabled = false;
+    std::array<int32_t, 3> index{-1, -1, -1};
+
+    bool Any() const { return this->enabled && (index[0] >= 0 || index[1] >= 0 || index[2] >= 0); }
+};
+
 class BaseSimulation {
 public:
     virtual ~BaseSimulation() = default;
@@ -32,13 +43,80 @@ public:
       // test function, only applicable to FDTD simulations
     }
 
+    virtual void CyclePalette()
+    {
+      // only applicable to simulations colouring a field (FDTD)
+    }
+
+    // Only the voxels on these planes are going to be drawn, simulations
+    // with expensive colouring can skip the rest (the other voxels are
+    // undefined until the slices are disabled again)
+    virtual void SetSlices(const Slices& new_slices)
+    {
+        this->slices = new_slices;
+    }
+
+    // True when there is nothing more to simulate (e.g. the field
+    // has decayed), used to terminate headless runs
+    virtual bool Finished() const
+    {
+        return false;
+    }
+
+    // Saving and restoring the full simulation state, return false when
+    // not supported by the simulation (or on error)
+    virtual bool SaveCheckpoint(const std::string& filename)
+    {
+        Log::warning("Checkpoints not supported by this simulation");
+        return false;
+    }
+
+    virtual bool LoadCheckpoint(const std::string& filename)
+    {
+        Log::warning("Checkpoints not supported by this simulation");
+        return false;
+    }
+
+    // Recordings can be rewound: the number of steps, the one shown, jumping
+    // to any of them and playing backwards. Not supported by the others.
+    virtual uint64_t StepCount() const
+    {
+        return 0;
+    }
+
+    virtual uint64_t CurrentStep() const
+    {
+        return 0;
+    }
+
+    virtual bool SeekStep(uint64_t step)
+    {
+        Log::warning("Seeking only supported in playback");
+        return false;
+    }
+
+    virtual bool SetReverse(bool reverse)
+    {
+        Log::warning("Playing backwards only supported in playback");
+        return false;
+    }
+
+    // Anything worth knowing beyond the step times, e.g. how recording keeps up
+    virtual void LogStats() {}
+
     virtual inline const utils::Vec<int32_t, 3>& GetGridSize() const
     {
         return gridSize;
     }
 
-    virtual inline const std::vector<Voxel, utils::TrackingAllocator<Voxel>>& GetVoxels() const
+    // Colours are only computed for the frames somebody looks at (rendered,
+    // recorded), by the first call after the state changed
+    virtual inline const VoxelBuffer& GetVoxels()
     {
+        if (this->colors_stale) {
+            this->colors_stale = false;
+            VoxelToColor();
+        }
         return voxels;
     }
 
@@ -72,15 +150,27 @@ public:
 
 protected:
     utils::Vec<int32_t, 3> gridSize;
-    std::vector<Voxel, utils::TrackingAllocator<Voxel>> voxels;
+    VoxelBuffer voxels;
     double simulation_time = 0.0;
     double step = 1.0;
+    Slices slices;
+    bool colors_stale = false;
+
+    // Fills the voxel colours from the simulation state
+    virtual void VoxelToColor()
+    {
+    }
+
+    // The state changed (step, reset, palette, ...), the colours are
+    // recomputed on the next GetVoxels instead of right away
+    void InvalidateColors()
+    {
+        this->colors_stale = true;
+    }
 
     void ResizeVoxels()
     {
-        auto [rows, cols, stacks] = this->gridSize.elements;
-        auto size = rows * cols * stacks;
-        this->voxels.resize(size);
+        this->voxels.Resize(this->gridSize);
     }
 };
 
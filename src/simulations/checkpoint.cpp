@@ -0,0 +1,98 @@
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+#include "log.hpp"
+#include "simulations/checkpoint.hpp"
+
+namespace Simulation {
+
+uint64_t HashDoubles(uint64_t hash, const double* data, size_t count)
+{
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < count * sizeof(double); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool ReadCheckpoint(const std::string& filename, CheckpointHeader& header, std::vector<double>& state)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        Log::error("Failed to open checkpoint ", filename);
+        return false;
+    }
+    CheckpointHeader expected;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file.fail() || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+        Log::error("Not a checkpoint file: ", filename);
+        return false;
+    }
+    if (header.version != CheckpointHeader::VERSION) {
+        Log::error("Unsupported checkpoint version ", header.version, " in ", filename);
+        return false;
+    }
+    // the header may be damaged or foreign, it only gets to size the state once it fits the file
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(filename, error);
+    if (error || file_size < sizeof(header) ||
+        header.state_size != (file_size - sizeof(header)) / sizeof(double)) {
+        Log::error("Checkpoint ", filename, " has wrong size");
+        return false;
+    }
+    state.resize(header.state_size);
+    file.read(reinterpret_cast<char*>(state.data()), sizeof(double) * state.size());
+    if (file.fail()) {
+        Log::error("Checkpoint ", filename, " is truncated");
+        return false;
+    }
+    return true;
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    Wait();
+}
+
+std::vector<double>& CheckpointWriter::Staging()
+{
+    Wait();
+    return this->staging;
+}
+
+void CheckpointWriter::WriteAsync(const std::string& filename, CheckpointHeader header)
+{
+    Wait();
+    header.state_size = this->staging.size();
+    this->thread = std::thread([this, filename, header]() {
+        auto tmp_filename = filename + ".tmp";
+        {
+            std::ofstream file(tmp_filename, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(this->staging.data()),
+                       sizeof(double) * this->staging.size());
+            if (file.fail()) {
+                Log::error("Failed to write checkpoint ", tmp_filename);
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(tmp_filename, filename, error);
+        if (error) {
+            Log::error("Failed to rename checkpoint to ", filename, ": ", error.message());
+            return;
+        }
+        Log::info("Saved checkpoint ", filename);
+    });
+}
+
+void CheckpointWriter::Wait()
+{
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include "utilities.hpp"
+
+namespace Simulation {
+
+/**
+ * Binary checkpoint file: header followed by the raw simulation state
+ * (doubles, in the order the simulation serializes them)
+ */
+struct CheckpointHeader {
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8] = {'G', '3', 'L', 'C', 'H', 'K', 'P', 'T'};
+    uint32_t version = VERSION;
+    int32_t grid[3] = {0, 0, 0};
+    uint64_t materials_hash = 0; // state is only valid for the same materials
+    uint64_t state_size = 0;     // number of doubles following the header
+};
+
+// FNV-1a, used to fingerprint the material coefficients
+uint64_t HashDoubles(uint64_t hash, const double* data, size_t count);
+
+// Reads and validates the header, then the whole state in one read
+bool ReadCheckpoint(const std::string& filename, CheckpointHeader& header, std::vector<double>& state);
+
+/**
+ * Writes checkpoints in the background.
+ *
+ * The simulation copies its state into the staging buffer (a plain
+ * memcpy of the field rows) and goes on; the snapshot is written with
+ * a single large write into a temporary file, which is then renamed,
+ * so an interrupted write never corrupts the previous checkpoint.
+ */
+class CheckpointWriter {
+public:
+    CheckpointWriter() = default;
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Buffer for the next snapshot, waits for the previous write to finish
+    std::vector<double>& Staging();
+    void WriteAsync(const std::string& filename, CheckpointHeader header);
+    void Wait();
+
+private:
+    std::vector<double> staging;
+    std::thread thread;
+};
+
+}
@@ -0,0 +1,86 @@
+#include <cassert>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+
+#include "simulations/checkpoint.hpp"
+#include "simulations/fdtd.hpp"
+#include "log.hpp"
+
+using namespace Simulation;
+
+std::vector<char> contents(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+int main(void)
+{
+    auto dir = std::filesystem::temp_directory_path();
+    auto first = (dir / "checkpoint_test_1.chk").string();
+    auto second = (dir / "checkpoint_test_2.chk").string();
+    auto restarted = (dir / "checkpoint_test_3.chk").string();
+    constexpr int steps = 10;
+
+    // save -> load -> step gives the very same state as going on without a restart
+    {
+        FDTD_3D sim(24, 24, 24);
+        for (int step = 0; step < steps; step++) {
+            sim.Step(0.0);
+        }
+        assert(sim.SaveCheckpoint(first));
+        for (int step = 0; step < steps; step++) {
+            sim.Step(0.0);
+        }
+        assert(sim.SaveCheckpoint(second));
+    }
+    {
+        FDTD_3D sim(24, 24, 24);
+        for (int step = 0; step < 3 * steps; step++) {
+            sim.Step(0.0);
+        }
+        assert(sim.GetEnergyMonitor().PeakEnergy() > 0.0);
+        assert(sim.LoadCheckpoint(first));
+        // the energy history of the run before the restart is gone
+        assert(sim.GetEnergyMonitor().PeakEnergy() == 0.0 && !sim.Finished());
+        for (int step = 0; step < steps; step++) {
+            sim.Step(0.0);
+        }
+        assert(sim.SaveCheckpoint(restarted));
+        // loading right after saving waits for the write
+        assert(sim.LoadCheckpoint(restarted));
+    }
+    auto expected = contents(second);
+    assert(expected.size() > sizeof(CheckpointHeader));
+    assert(contents(restarted) == expected);
+
+    // other grid sizes are rejected
+    {
+        FDTD_3D sim(20, 20, 20);
+        assert(!sim.LoadCheckpoint(first));
+    }
+
+    // a damaged header can't make the reader allocate whatever it says
+    {
+        std::fstream file(first, std::ios::binary | std::ios::in | std::ios::out);
+        CheckpointHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        header.state_size = 1ull << 60;
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    CheckpointHeader header;
+    std::vector<double> state;
+    assert(!ReadCheckpoint(first, header, state));
+    assert(state.empty());
+
+    // truncated
+    std::filesystem::resize_file(second, expected.size() - sizeof(double));
+    assert(!ReadCheckpoint(second, header, state));
+
+    for (const auto& filename : {first, second, restarted}) {
+        std::filesystem::remove(filename);
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLORMAP_SSE2
+#endif
+
+#include "simulations/colormap.hpp"
+
+namespace Simulation {
+
+constexpr int32_t LUT_MAX = static_cast<int32_t>(Colormap::LUT_SIZE) - 1;
+// LOG palette: float exponent and top 6 mantissa bits, 64 entries per octave,
+// value / range == 1.0 (exponent 127) maps one past the last entry
+constexpr int32_t LOG_SHIFT = 23 - 6;
+constexpr int32_t LOG_OFFSET = (127 << 6) - static_cast<int32_t>(Colormap::LUT_SIZE);
+
+static uint32_t Pack(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    uint8_t bytes[4] = {r, g, b, a};
+    uint32_t packed;
+    std::memcpy(&packed, bytes, sizeof(packed));
+    return packed;
+}
+
+const char* PaletteName(Palette palette)
+{
+    switch (palette) {
+        case Palette::LINEAR: return "linear";
+        case Palette::DIVERGING: return "diverging";
+        case Palette::LOG: return "log";
+    }
+    return "unknown";
+}
+
+Palette NextPalette(Palette palette)
+{
+    return static_cast<Palette>((static_cast<uint8_t>(palette) + 1) % 3);
+}
+
+Colormap::Colormap(Palette palette, double range) :
+    palette(palette),
+    range(range)
+{
+    BuildLUT();
+}
+
+void Colormap::SetPalette(Palette palette)
+{
+    this->palette = palette;
+    BuildLUT();
+}
+
+void Colormap::SetRange(double range)
+{
+    if (!(range > 0.0)) {
+        Log::warning("Colormap range has to be positive, got ", range);
+        return;
+    }
+    this->range = range;
+    BuildLUT();
+}
+
+void Colormap::BuildLUT()
+{
+    // green (small) to red (large), more opaque with the strength
+    auto ramp = [](double c) {
+        return Pack(static_cast<uint8_t>(c * 255), static_cast<uint8_t>((1 - c) * 255), 0,
+                    static_cast<uint8_t>(c * 255));
+    };
+
+    for (int32_t key = 0; key <= LUT_MAX; key++) {
+        uint32_t color = 0;
+        switch (this->palette) {
+            case Palette::LINEAR:
+                color = ramp(static_cast<double>(key) / LUT_MAX);
+                break;
+            case Palette::DIVERGING: {
+                // centre of the bin in -1..1, white around zero (but transparent)
+                double t = (key + 0.5) / LUT_SIZE * 2.0 - 1.0;
+                auto fade = static_cast<uint8_t>((1.0 - std::abs(t)) * 255);
+                auto alpha = static_cast<uint8_t>(std::abs(t) * 255);
+                color = t < 0 ? Pack(fade, fade, 255, alpha) : Pack(255, fade, fade, alpha);
+                break;
+            }
+            case Palette::LOG:
+                color = key == 0 ? 0 : ramp(static_cast<double>(key) / LUT_MAX);
+                break;
+        }
+        this->lut[key] = color;
+        this->lut_visible[key] = reinterpret_cast<const uint8_t*>(&color)[3] != 0;
+    }
+
+    switch (this->palette) {
+        case Palette::LINEAR: this->scale = LUT_MAX / this->range; break;
+        case Palette::DIVERGING: this->scale = (LUT_SIZE / 2) / this->range; break;
+        case Palette::LOG: this->scale = 1.0 / this->range; break;
+    }
+}
+
+// Scalar version of the key computation in MapLine, NaN and inf saturate
+int32_t Colormap::Index(double value) const
+{
+    switch (this->palette) {
+        case Palette::LINEAR: {
+            double x = std::abs(value) * this->scale;
+            return x < LUT_MAX ? static_cast<int32_t>(x) : LUT_MAX;
+        }
+        case Palette::DIVERGING: {
+            double x = value * this->scale + static_cast<double>(LUT_SIZE / 2);
+            x = x < LUT_MAX ? x : LUT_MAX;
+            return x > 0.0 ? static_cast<int32_t>(x) : 0;
+        }
+        case Palette::LOG: {
+            float f = static_cast<float>(std::abs(value) * this->scale);
+            int32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            return std::clamp((bits >> LOG_SHIFT) - LOG_OFFSET, 0, LUT_MAX);
+        }
+    }
+    return 0;
+}
+
+utils::Color Colormap::operator()(double value) const
+{
+    uint8_t bytes[4];
+    std::memcpy(bytes, &this->lut[Index(value)], sizeof(bytes));
+    return utils::Color{bytes[0], bytes[1], bytes[2], bytes[3]};
+}
+
+template <bool BUCKETED>
+void Colormap::MapLine(const double* values, size_t count, uint8_t* colors,
+                       size_t first, size_t stride, Part& part) const
+{
+    // branchless, most of the voxels change and/or are visible in a wave front
+    const uint32_t* lut = this->lut.data();
+    const uint8_t* lut_visible = this->lut_visible.data();
+    uint8_t* changed = part.changed.data();
+    uint32_t* visible = part.visible.data();
+    uint32_t* fill = part.fill.data();
+    size_t bucket_size = part.bucket_size;
+    size_t n_visible = fill[0];
+    auto store = [&](size_t n, int32_t key) {
+        size_t index = first + n * stride;
+        uint32_t color = lut[key];
+        uint32_t old_color;
+        std::memcpy(&old_color, colors + 4 * index, sizeof(old_color));
+        std::memcpy(colors + 4 * index, &color, sizeof(color));
+        changed[index / VoxelBuffer::CHUNK] |= old_color != color;
+        if constexpr (BUCKETED) {
+            visible[n * bucket_size + fill[n]] = static_cast<uint32_t>(index);
+            fill[n] += lut_visible[key];
+        } else {
+            visible[n_visible] = static_cast<uint32_t>(index);
+            n_visible += lut_visible[key];
+        }
+    };
+
+    size_t n = 0;
+#ifdef COLORMAP_SSE2
+    // 4 keys per iteration, same operations (and NaN handling) as Index():
+    // minpd/maxpd return the second operand when the first one is NaN
+    const __m128d abs_mask = _mm_castsi128_pd(_mm_set_epi32(0x7fffffff, -1, 0x7fffffff, -1));
+    const __m128d scale = _mm_set1_pd(this->scale);
+    const __m128d max_key = _mm_set1_pd(LUT_MAX);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d half = _mm_set1_pd(static_cast<double>(LUT_SIZE / 2));
+    alignas(16) int32_t keys[4];
+
+    auto keys2 = [&](const double* in) -> __m128i {
+        __m128d v = _mm_loadu_pd(in);
+        switch (this->palette) {
+            case Palette::LINEAR: {
+                __m128d x = _mm_mul_pd(_mm_and_pd(v, abs_mask), scale);
+                return _mm_cvttpd_epi32(_mm_min_pd(x, max_key));
+            }
+            case Palette::DIVERGING: {
+                __m128d x = _mm_add_pd(_mm_mul_pd(v, scale), half);
+                return _mm_cvttpd_epi32(_mm_max_pd(_mm_min_pd(x, max_key), zero));
+            }
+            case Palette::LOG: {
+                __m128 f = _mm_cvtpd_ps(_mm_mul_pd(_mm_and_pd(v, abs_mask), scale));
+                return _mm_srli_epi32(_mm_castps_si128(f), LOG_SHIFT);
+            }
+        }
+        return _mm_setzero_si128();
+    };
+
+    for (; n + 4 <= count; n += 4) {
+        __m128i k = _mm_unpacklo_epi64(keys2(values + n), keys2(values + n + 2));
+        if (this->palette == Palette::LOG) {
+            // no 32 bit min/max in SSE2, but the keys fit in 16 bits
+            k = _mm_sub_epi32(k, _mm_set1_epi32(LOG_OFFSET));
+            __m128i k16 = _mm_packs_epi32(k, k);
+            k16 = _mm_max_epi16(_mm_min_epi16(k16, _mm_set1_epi16(LUT_MAX)), _mm_setzero_si128());
+            k = _mm_unpacklo_epi16(k16, _mm_setzero_si128());
+        }
+        _mm_store_si128(reinterpret_cast<__m128i*>(keys), k);
+        store(n, keys[0]);
+        store(n + 1, keys[1]);
+        store(n + 2, keys[2]);
+        store(n + 3, keys[3]);
+    }
+#endif
+    for (; n < count; n++) {
+        store(n, Index(values[n]));
+    }
+    if constexpr (!BUCKETED) {
+        fill[0] = static_cast<uint32_t>(n_visible);
+    }
+}
+
+void Colormap::Apply(VoxelBuffer& voxels, const std::vector<const double*>& lines, size_t count,
+                     size_t line_step, size_t stride, bool parallel, size_t first)
+{
+    voxels.BeginFrame();
+    Append(voxels, lines, count, line_step, stride, parallel, first);
+}
+
+void Colormap::Append(VoxelBuffer& voxels, const std::vector<const double*>& lines, size_t count,
+                      size_t line_step, size_t stride, bool parallel, size_t first)
+{
+    if (lines.empty() || count == 0) {
+        return;
+    }
+    size_t tasks = 1;
+    if (parallel) {
+        // a few tasks per thread so that uneven lines even out
+        tasks = std::min<size_t>(lines.size(), 4 * std::max(1u, std::thread::hardware_concurrency()));
+    }
+    // with the values of a line a stride of all the lines apart (FDTD fields),
+    // index order is value n of every line before value n + 1 of any, so
+    // the visible voxels of every task are kept apart per n
+    bool bucketed = count > 1 && line_step > 0 && stride >= line_step * lines.size();
+    // the parts are kept from call to call, a slice only costs what it colours:
+    // the buffers only grow and the changed flags are cleared as they are merged
+    if (this->parts.size() < tasks) {
+        this->parts.resize(tasks);
+    }
+    for (size_t t = 0; t < tasks; t++) {
+        auto& part = this->parts[t];
+        size_t task_lines = lines.size() * (t + 1) / tasks - lines.size() * t / tasks;
+        if (part.visible.size() < task_lines * count) {
+            part.visible.resize(task_lines * count);
+        }
+        part.fill.assign(bucketed ? count : 1, 0);
+        part.bucket_size = task_lines;
+        if (part.changed.size() != voxels.chunk_version.size()) {
+            part.changed.assign(voxels.chunk_version.size(), 0);
+        }
+    }
+
+    uint8_t* colors = voxels.Data();
+    auto task = [&](size_t t) {
+        auto& part = this->parts[t];
+        size_t begin = lines.size() * t / tasks;
+        size_t end = lines.size() * (t + 1) / tasks;
+        for (size_t l = begin; l < end; l++) {
+            if (bucketed) {
+                MapLine<true>(lines[l], count, colors, first + l * line_step, stride, part);
+            } else {
+                MapLine<false>(lines[l], count, colors, first + l * line_step, stride, part);
+            }
+        }
+    };
+    if (tasks > 1) {
+        utils::ParallelFor(tasks, task);
+    } else {
+        task(0);
+    }
+
+    // only the chunks this call wrote to, a run of them per n (bucketed) or per line
+    auto merge_changed = [&](size_t from, size_t to) {
+        for (size_t chunk = from / VoxelBuffer::CHUNK; chunk <= to / VoxelBuffer::CHUNK; chunk++) {
+            bool changed = false;
+            for (size_t t = 0; t < tasks; t++) {
+                changed = changed || this->parts[t].changed[chunk];
+                this->parts[t].changed[chunk] = 0;
+            }
+            if (changed) {
+                voxels.chunk_version[chunk] = voxels.version;
+            }
+        }
+    };
+    if (bucketed) {
+        for (size_t n = 0; n < count; n++) {
+            merge_changed(first + n * stride, first + n * stride + (lines.size() - 1) * line_step);
+        }
+    } else {
+        for (size_t l = 0; l < lines.size(); l++) {
+            merge_changed(first + l * line_step, first + l * line_step + (count - 1) * stride);
+        }
+    }
+    for (size_t bucket = 0; bucket < this->parts[0].fill.size(); bucket++) {
+        for (size_t t = 0; t < tasks; t++) {
+            const auto& part = this->parts[t];
+            auto begin = part.visible.begin() + bucket * part.bucket_size;
+            voxels.visible.insert(voxels.visible.end(), begin, begin + part.fill[bucket]);
+        }
+    }
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "utilities.hpp"
+#include "voxel.hpp"
+
+namespace Simulation {
+
+enum class Palette : uint8_t {
+    LINEAR,    // |value|, green to red, transparent at zero
+    DIVERGING, // sign matters, blue (negative) to red (positive)
+    LOG,       // |value| over 16 octaves, shows the small amplitudes too
+};
+
+const char* PaletteName(Palette palette);
+Palette NextPalette(Palette palette);
+
+/**
+ * Maps field values to voxel colours.
+ *
+ * The palette is precomputed into a lookup table of LUT_SIZE colours for
+ * the given range (values with |value| >= range saturate). Apply() then
+ * only quantizes the values to LUT indices (with SSE2 when available, two
+ * doubles per instruction) and copies the colours, keeping the visible
+ * list and the change tracking of the VoxelBuffer up to date.
+ *
+ * The LOG palette takes the index from the bits of the float value
+ * (exponent and the top 6 bits of the mantissa), so it doesn't need
+ * a log per voxel either.
+ */
+class Colormap {
+public:
+    static constexpr size_t LUT_SIZE = 1024;
+
+    explicit Colormap(Palette palette = Palette::LINEAR, double range = 0.2);
+
+    void SetPalette(Palette palette);
+    void SetRange(double range);
+    Palette GetPalette() const { return palette; }
+    double GetRange() const { return range; }
+
+    // Single value, same result as Apply
+    utils::Color operator()(double value) const;
+
+    /**
+     * Colours a whole field stored as lines of count contiguous values,
+     * value n of line l goes to voxel first + l * line_step + n * stride.
+     * This is a complete frame (see VoxelBuffer::BeginFrame).
+     */
+    void Apply(VoxelBuffer& voxels, const std::vector<const double*>& lines, size_t count,
+               size_t line_step, size_t stride, bool parallel = false, size_t first = 0);
+
+    // Same as Apply, but adds to the current frame (e.g. several slices of a field).
+    // The visible voxels are added in index order when the lines are (line_step
+    // > 0), as long as the values of a line are either adjacent or a stride of
+    // all the lines apart, like the stacks of an FDTD field.
+    void Append(VoxelBuffer& voxels, const std::vector<const double*>& lines, size_t count,
+                size_t line_step, size_t stride, bool parallel = false, size_t first = 0);
+
+private:
+    Palette palette;
+    double range;
+    double scale = 0.0;     // value to LUT index
+    std::array<uint32_t, LUT_SIZE> lut;  // packed RGBA in memory order
+    std::array<uint8_t, LUT_SIZE> lut_visible;
+
+    // per thread results of Apply, merged into the VoxelBuffer at the end
+    struct Part {
+        std::vector<uint32_t> visible; // room for all the voxels of the part
+        // visible voxels, per value n of the lines when bucketed (see Append)
+        // and then the ones of n start at n * bucket_size in visible
+        std::vector<uint32_t> fill;
+        size_t bucket_size = 0;
+        std::vector<uint8_t> changed;  // per VoxelBuffer chunk, all clear between calls
+    };
+    std::vector<Part> parts;
+
+    void BuildLUT();
+    int32_t Index(double value) const;
+    // Writes the visible voxels of a line to the part
+    template <bool BUCKETED>
+    void MapLine(const double* values, size_t count, uint8_t* colors,
+                 size_t first, size_t stride, Part& part) const;
+};
+
+}
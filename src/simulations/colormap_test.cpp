@@ -0,0 +1,138 @@
+#include <random>
+#include <limits>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#include "simulations/colormap.hpp"
+#include "log.hpp"
+
+using namespace Simulation;
+
+bool same(utils::Color a, utils::Color b)
+{
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+int main(void)
+{
+    constexpr int32_t rows = 13, cols = 7, stacks = 37; // not multiples of the SIMD width
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(-0.3, 0.3);
+    std::vector<std::vector<double>> field(rows * cols, std::vector<double>(stacks));
+    for (auto& line : field) {
+        for (auto& value : line) {
+            value = dist(rng);
+        }
+    }
+    field[0][0] = 0.0;
+    field[0][1] = -0.0;
+    field[0][2] = inf;
+    field[0][3] = -inf;
+    field[0][4] = nan;
+    field[0][5] = 1e-30;
+    field[0][6] = -1e300;
+    field[1][0] = 0.2;
+
+    std::vector<const double*> lines;
+    for (const auto& line : field) {
+        lines.push_back(line.data());
+    }
+
+    for (auto palette : {Palette::LINEAR, Palette::DIVERGING, Palette::LOG}) {
+        Colormap colormap(palette);
+        for (bool parallel : {false, true}) {
+            VoxelBuffer voxels;
+            voxels.Resize({rows, cols, stacks});
+            colormap.Apply(voxels, lines, stacks, 1, rows * cols, parallel);
+
+            // same colours as the scalar version, same visible voxels
+            size_t visible = 0;
+            for (int32_t l = 0; l < rows * cols; l++) {
+                for (int32_t s = 0; s < stacks; s++) {
+                    auto expected = colormap(field[l][s]);
+                    assert(same(voxels.colors[l + s * rows * cols], expected));
+                    visible += expected[3] != 0;
+                }
+            }
+            assert(voxels.visible.size() == visible);
+            for (auto index : voxels.visible) {
+                assert(voxels.colors[index][3] != 0);
+            }
+            // in index order although the lines run across the planes
+            assert(std::is_sorted(voxels.visible.begin(), voxels.visible.end()));
+
+            // nothing changed, no chunk gets a new version
+            uint64_t version = voxels.version;
+            colormap.Apply(voxels, lines, stacks, 1, rows * cols, parallel);
+            voxels.ForEachChangedRange(version, [](size_t, size_t) { assert(false); });
+            assert(voxels.visible.size() == visible);
+        }
+
+        // a single plane only marks its own chunks, and leaves no flags behind for the next frame
+        for (bool parallel : {false, true}) {
+            constexpr int32_t stack = 30;
+            constexpr size_t plane = rows * cols;
+            VoxelBuffer voxels;
+            voxels.Resize({rows, cols, stacks});
+            colormap.Apply(voxels, lines, stacks, 1, plane, parallel);
+            auto plane_field = field;
+            std::vector<const double*> plane_lines;
+            for (auto& line : plane_field) {
+                line[stack] = line[stack] > 0.0 ? -0.25 : 0.25;
+                plane_lines.push_back(&line[stack]);
+            }
+            uint64_t version = voxels.version;
+            voxels.BeginFrame();
+            colormap.Append(voxels, plane_lines, 1, 1, 0, parallel, stack * plane);
+            assert(voxels.visible.size() <= plane);
+            size_t changed = 0;
+            voxels.ForEachChangedRange(version, [&](size_t begin, size_t end) {
+                assert(begin >= stack * plane / VoxelBuffer::CHUNK * VoxelBuffer::CHUNK);
+                assert(end <= ((stack + 1) * plane / VoxelBuffer::CHUNK + 1) * VoxelBuffer::CHUNK);
+                changed += end - begin;
+            });
+            assert(changed > 0);
+            for (size_t l = 0; l < plane; l++) {
+                assert(same(voxels.colors[l + stack * plane], colormap(plane_field[l][stack])));
+            }
+            lines.clear();
+            for (const auto& line : plane_field) {
+                lines.push_back(line.data());
+            }
+            version = voxels.version;
+            colormap.Apply(voxels, lines, stacks, 1, plane, parallel);
+            voxels.ForEachChangedRange(version, [](size_t, size_t) { assert(false); });
+            lines.clear();
+            for (const auto& line : field) {
+                lines.push_back(line.data());
+            }
+        }
+        Log::debug(PaletteName(palette), " ok");
+    }
+
+    // saturation and the original green to red ramp
+    Colormap linear(Palette::LINEAR, 0.2);
+    assert(linear(0.0)[3] == 0);
+    assert(linear(0.0)[1] == 255);
+    assert(same(linear(0.2), linear(5.0)));
+    assert(same(linear(-0.2), linear(nan)));
+    assert(linear(0.2)[0] == 255 && linear(0.2)[3] == 255);
+
+    Colormap diverging(Palette::DIVERGING, 0.2);
+    assert(diverging(0.0)[3] == 0);
+    assert(diverging(-0.2)[2] == 255 && diverging(-0.2)[0] < 10);
+    assert(diverging(0.2)[0] == 255 && diverging(0.2)[2] < 10);
+
+    // small values still visible with the log palette
+    Colormap log(Palette::LOG, 0.2);
+    assert(linear(1e-4)[3] == 0);
+    assert(log(1e-4)[3] != 0);
+    assert(log(0.0)[3] == 0);
+    assert(log(1e-3)[3] < log(1e-2)[3]);
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+
+#include "log.hpp"
+
+namespace Simulation {
+
+/**
+ * Tracks the total electromagnetic energy and the Poynting flux of a
+ * simulation. The sums are accumulated by the simulation in its update
+ * passes and handed over once per step (normalized units, only
+ * relative values are meaningful).
+ *
+ * A pulse simulation is considered done once the energy falls below
+ * stop_threshold * peak energy.
+ */
+class EnergyMonitor {
+public:
+    void Update(double electric, double magnetic, double flux)
+    {
+        this->electric = electric;
+        this->magnetic = magnetic;
+        this->flux = flux;
+        this->peak = std::max(this->peak, Energy());
+        if (!this->converged && this->stop_threshold > 0.0 &&
+            this->peak > 0.0 && Energy() < this->stop_threshold * this->peak) {
+            this->converged = true;
+            Log::info("Energy dropped to ", Energy() / this->peak, " of its peak, simulation done");
+        }
+    }
+
+    void Reset()
+    {
+        electric = magnetic = flux = peak = 0.0;
+        converged = false;
+    }
+
+    // 0 disables the convergence check
+    void SetStopThreshold(double relative) { stop_threshold = relative; }
+
+    double Energy() const { return electric + magnetic; }
+    double ElectricEnergy() const { return electric; }
+    double MagneticEnergy() const { return magnetic; }
+    double PeakEnergy() const { return peak; }
+    double Flux() const { return flux; } // outgoing
+    bool Converged() const { return converged; }
+
+private:
+    double electric = 0.0;
+    double magnetic = 0.0;
+    double flux = 0.0;
+    double peak = 0.0;
+    double stop_threshold = 1e-4;
+    bool converged = false;
+};
+
+}
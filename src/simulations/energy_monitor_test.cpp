@@ -0,0 +1,78 @@
+#include <cmath>
+#include <cassert>
+
+#include "simulations/energy_monitor.hpp"
+#include "simulations/fdtd.hpp"
+#include "log.hpp"
+
+using namespace Simulation;
+
+int main(void)
+{
+    // the peak follows the total, done once below the threshold and only then
+    {
+        EnergyMonitor monitor;
+        monitor.SetStopThreshold(0.1);
+        monitor.Update(1.0, 2.0, 0.5);
+        assert(monitor.Energy() == 3.0 && monitor.PeakEnergy() == 3.0 && monitor.Flux() == 0.5);
+        monitor.Update(4.0, 6.0, 1.0);
+        assert(monitor.PeakEnergy() == 10.0 && !monitor.Converged());
+        monitor.Update(0.6, 0.5, 0.0);
+        assert(monitor.PeakEnergy() == 10.0 && !monitor.Converged());
+        monitor.Update(0.5, 0.4, 0.0);
+        assert(monitor.Converged());
+        // stays done when the energy comes back
+        monitor.Update(5.0, 5.0, 0.0);
+        assert(monitor.Converged());
+        monitor.Reset();
+        assert(!monitor.Converged() && monitor.PeakEnergy() == 0.0);
+
+        // no energy at all (nothing excited yet) is not done
+        monitor.Update(0.0, 0.0, 0.0);
+        assert(!monitor.Converged());
+        // 0 never stops
+        monitor.SetStopThreshold(0.0);
+        monitor.Update(1.0, 0.0, 0.0);
+        monitor.Update(0.0, 0.0, 0.0);
+        assert(!monitor.Converged());
+    }
+
+    // a pulse in a PML box: the energy builds up, flows out and the run stops
+    constexpr int max_steps = 1000;
+    int finished_at = 0;
+    {
+        FDTD_3D sim(24, 24, 24);
+        sim.SetStopThreshold(1e-2);
+        double flux_out = 0.0;
+        for (int step = 1; step <= max_steps && !sim.Finished(); step++) {
+            sim.Step(0.0);
+            const auto& energy = sim.GetEnergyMonitor();
+            assert(energy.ElectricEnergy() >= 0.0 && energy.MagneticEnergy() >= 0.0);
+            assert(energy.Energy() <= energy.PeakEnergy());
+            flux_out = std::max(flux_out, energy.Flux());
+            finished_at = step;
+        }
+        const auto& energy = sim.GetEnergyMonitor();
+        Log::debug("finished after ", finished_at, " steps, peak energy ", energy.PeakEnergy());
+        assert(sim.Finished() && finished_at < max_steps);
+        assert(energy.PeakEnergy() > 0.0 && energy.Energy() < 1e-2 * energy.PeakEnergy());
+        assert(flux_out > 0.0);
+    }
+
+    // the same run must not stop while the pulse is still in the box, nor ever without a threshold
+    {
+        FDTD_3D sim(24, 24, 24);
+        sim.SetStopThreshold(1e-2);
+        for (int step = 1; step < finished_at; step++) {
+            sim.Step(0.0);
+        }
+        assert(!sim.Finished());
+        sim.SetStopThreshold(0.0);
+        for (int step = finished_at; step <= finished_at + 50; step++) {
+            sim.Step(0.0);
+        }
+        assert(!sim.Finished());
+    }
+
+    return 0;
+}
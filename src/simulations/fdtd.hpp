@@ -1,40 +1,37 @@
 #pragma once
 
 #include <algorithm>
+#include <memory>
 #include <cmath>
 
 #include "simulations/base.hpp"
+#include "simulations/probes.hpp"
+#include "simulations/fdtd_ensemble.hpp"
+#include "simulations/checkpoint.hpp"
+#include "simulations/energy_monitor.hpp"
+#include "simulations/colormap.hpp"
 #include "utilities.hpp"
+#include "geometry.hpp"
 
 namespace Simulation {
 
-inline utils::Color FieldStrengthToColor(double fieldValue)
-{
-    constexpr double amplification = 5.0;
-    double c = std::clamp(std::abs(amplification * fieldValue), 0.0, 1.0);
-    uint8_t R = static_cast<uint8_t>( c * 255 );
-    uint8_t G = static_cast<uint8_t>( (1 - c) * 255 );
-    uint8_t B = static_cast<uint8_t>( 0 );
-    uint8_t alpha = static_cast<uint8_t>( c * 255 );
-
-    return utils::Color{R, G, B, alpha};
-}
-
 class FDTD_1D : public BaseSimulation {
 public:
 
     FDTD_1D(uint32_t rows) :
-        BaseSimulation(rows, 1, 1)
+        FDTD_1D(rows, FDTD_1D_Case{4.0, static_cast<int32_t>(rows / 2)})
+    {
+    }
+
+    // Same configuration as a case of FDTD_1D_Ensemble
+    FDTD_1D(uint32_t rows, const FDTD_1D_Case& config) :
+        BaseSimulation(rows, 1, 1),
+        config(config)
     {
         ex = std::unique_ptr<double[]>(new double[rows]);
         hy = std::unique_ptr<double[]>(new double[rows]);
         cb = std::unique_ptr<double[]>(new double[rows]);
 
-        const uint32_t col = 1, stack = 1;
-        for (uint32_t row = 0; row < rows; row++)
-        {
-            this->voxels[row].position = { row, col, stack };
-        }
         InitRandomState();
     }
 
@@ -54,13 +51,14 @@ public:
         dt = dx/(2*utils::constants::C0); // Time step [s]
         T = 0.0;        // Time
     
-        kstart  = KE/2;  // Boundary between mediums 1 and 2
-        epsilon = 4.0;  /* Relative dielectric constant of 
+        kstart  = config.slab_start; // Boundary between mediums 1 and 2
+        kend    = config.slab_end < 0 ? KE : config.slab_end;
+        epsilon = config.epsilon;  /* Relative dielectric constant of 
                                     medium 2 */
     
-        t0 = 80.0;      // Center of the incident pulse
-        spread = 40.0;  // Width of the incident pulse
-        freq_in = 2.0e9;// Signal Frequency [Hz]
+        t0 = config.t0;           // Center of the incident pulse
+        spread = config.spread;   // Width of the incident pulse
+        freq_in = config.freq_in; // Signal Frequency [Hz]
         carrier = 0.0;  // Signal carrier
         enveloppe = 0.0;// Signal enveloppe
     
@@ -72,7 +70,7 @@ public:
         ex_high_4 = 0.0;
 
         // Initialize the medium 2        
-        for (int k = kstart; k < KE; k++){ cb[k] = 1.0/epsilon; }
+        for (int k = kstart; k < kend; k++){ cb[k] = 1.0/epsilon; }
     }
 
     double Step(double _dt) override
@@ -90,7 +88,7 @@ public:
         // Put a Gaussian pulse in the middle
         carrier = sin(2.0*M_PI*freq_in*dt*T);
         enveloppe = exp( -0.5*pow((t0-T)/spread,2.0) );
-        ex[5] += carrier*enveloppe;
+        ex[config.source] += carrier*enveloppe;
             
         // Absorbing boundary conditions for Ex
         ex[0]     = ex_low_2;
@@ -108,7 +106,13 @@ public:
             hy[k] += 0.5*( ex[k] - ex[k+1] ); 
         }
 
-        VoxelToColor();
+        if (probes) {
+            probes->Sample(static_cast<uint64_t>(T), [this](Field field, int32_t i, int32_t, int32_t) {
+                return field == Field::EX ? ex[i] : field == Field::HY ? hy[i] : 0.0;
+            });
+        }
+
+        InvalidateColors();
 
         return dt;
     }
@@ -118,6 +122,21 @@ public:
 
     }
 
+    void CyclePalette() override
+    {
+        colormap.SetPalette(NextPalette(colormap.GetPalette()));
+        Log::info("Colormap: ", PaletteName(colormap.GetPalette()));
+        InvalidateColors();
+    }
+
+    // Probes are sampled at the end of every step,
+    // fields that the simulation does not have read as zero
+    void AttachProbes(std::unique_ptr<Probes> new_probes)
+    {
+        new_probes->Validate(gridSize);
+        probes = std::move(new_probes);
+    }
+
 private:
 
     int    KE,
@@ -126,7 +145,9 @@ private:
            dt;
     double T;
     
-    int    kstart;
+    FDTD_1D_Case config;
+    int    kstart,
+           kend;
     double epsilon;
     
     double t0;
@@ -146,6 +167,9 @@ private:
 
     std::unique_ptr<double[]> ex, hy, cb;
 
+    std::unique_ptr<Probes> probes;
+    Colormap colormap;
+
     void update_E()
     {
 
@@ -161,12 +185,9 @@ private:
 
     }
 
-    void VoxelToColor() {
+    void VoxelToColor() override {
       auto [rows, cols, stacks] = this->gridSize.elements;
-      for (int index = 0; index < rows * cols * stacks; ++index) {
-          this->voxels[index].color = FieldStrengthToColor(this->ex[index]);
-
-      }   
+      colormap.Apply(this->voxels, {this->ex.get()}, rows, 0, 1);
     }
 };
 
@@ -195,11 +216,10 @@ public:
                 hx[row][col] = 0.0;
                 hy[row][col] = 0.0;
                 ga[row][col] = 1.0;
-                uint32_t index = IndexFromSimCoords(row, col, stack);
-                voxels[index].position = {row, col, stack};
-                voxels[index].color = utils::black;
+                voxels.colors[IndexFromSimCoords(row, col, stack)] = utils::black;
             }
         }
+        voxels.MarkAllChanged();
         IE = rows;
         JE = cols;
         ic = IE / 2;
@@ -267,28 +287,52 @@ public:
                 hy[i][j] += 0.5*( ez[i+1][j] - ez[i][j] );
             }
         }
+
+        if (probes) {
+            probes->Sample(static_cast<uint64_t>(T), [this](Field field, int32_t i, int32_t j, int32_t) {
+                switch (field) {
+                    case Field::EZ: return ez[i][j];
+                    case Field::HX: return hx[i][j];
+                    case Field::HY: return hy[i][j];
+                    default:        return 0.0;
+                }
+            });
+        }
     
-        VoxelToColor();
+        InvalidateColors();
 
         return dt; // TODO
     }
 
-    void VoxelToColor() {
+    void VoxelToColor() override {
         auto [rows, cols, stacks] = this->gridSize.elements;
-        uint32_t stack = 0;
+        // TODO try something else other than ez
+        std::vector<const double*> lines(rows);
         for (int32_t row = 0; row < rows; row++) {
-            for (int32_t col = 0; col < cols; col++) {
-                // TODO try something else other than ez
-                uint32_t index = IndexFromSimCoords(row, col, stack);
-                this->voxels[index].color = FieldStrengthToColor(ez[row][col]);
-            }
+            lines[row] = ez[row].data();
         }
+        colormap.Apply(this->voxels, lines, cols, cols, 1);
+    }
+
+    void CyclePalette() override
+    {
+        colormap.SetPalette(NextPalette(colormap.GetPalette()));
+        Log::info("Colormap: ", PaletteName(colormap.GetPalette()));
+        InvalidateColors();
     }
 
     void TriggerSource() override {
       sourceAmplification = sourceAmplification > 0.01 ? 0.0 : 1.0;
     }
 
+    // Probes are sampled at the end of every step,
+    // fields that the simulation does not have read as zero
+    void AttachProbes(std::unique_ptr<Probes> new_probes)
+    {
+        new_probes->Validate(gridSize);
+        probes = std::move(new_probes);
+    }
+
 
 private:
 
@@ -305,6 +349,9 @@ private:
     
     double sourceAmplification = 1.0;
 
+    std::unique_ptr<Probes> probes;
+    Colormap colormap;
+
 };
 
 
@@ -329,9 +376,6 @@ public:
         hx.resize(IE, std::vector<vd>(JE, vd(KE)));
         hy.resize(IE, std::vector<vd>(JE, vd(KE)));
         hz.resize(IE, std::vector<vd>(JE, vd(KE)));
-        ix.resize(IE, std::vector<vd>(JE, vd(KE)));
-        iy.resize(IE, std::vector<vd>(JE, vd(KE)));
-        iz.resize(IE, std::vector<vd>(JE, vd(KE)));
         gax.resize(IE, std::vector<vd>(JE, vd(KE)));
         gay.resize(IE, std::vector<vd>(JE, vd(KE)));
         gaz.resize(IE, std::vector<vd>(JE, vd(KE)));
@@ -380,6 +424,21 @@ public:
         amp.resize(IE, vd(JE));
         phase.resize(IE, vd(JE));
 
+        // here the original source code asks the user for the spheres,
+        // we put two concentric ones in the middle of the grid
+        Geometry::Point center{IE/2, JE/2, KE/2};
+        auto lossy = scene.AddMaterial({30.0, 0.3});
+        auto dielectric = scene.AddMaterial({4.0, 0.0});
+        scene.AddSphere(center, std::min({IE, JE, KE}) / 5.0, lossy);
+        scene.AddSphere(center, std::min({IE, JE, KE}) / 10.0, dielectric);
+
+        InitRandomState();
+    }
+
+    // Replaces the objects in the simulation space and restarts the simulation
+    void SetScene(Geometry::Scene new_scene)
+    {
+        scene = std::move(new_scene);
         InitRandomState();
     }
 
@@ -396,6 +455,8 @@ public:
         ddx = 0.01;                 /* Cell size */
         dt = ddx / 6e8;             /* Time steps */
 
+        ez_low_m1 = ez_low_m2 = 0.0;
+        ez_high_m1 = ez_high_m2 = 0.0;
         for (int32_t j = 0; j < JE; j++) {
             ez_inc[j] = 0.0;
             hx_inc[j] = 0.0;
@@ -404,15 +465,12 @@ public:
                     dx[i][j][k] = 0.0;
                     dy[i][j][k] = 0.0;
                     dz[i][j][k] = 0.0;
-                    dx[i][j][k] = 0.0;
-                    dy[i][j][k] = 0.0;
-                    dz[i][j][k] = 0.0;
+                    ex[i][j][k] = 0.0;
+                    ey[i][j][k] = 0.0;
+                    ez[i][j][k] = 0.0;
                     hx[i][j][k] = 0.0;
                     hy[i][j][k] = 0.0;
                     hz[i][j][k] = 0.0;
-                    ix[i][j][k] = 0.0;
-                    iy[i][j][k] = 0.0;
-                    iz[i][j][k] = 0.0;
                     gax[i][j][k] = 1.0;
                     gay[i][j][k] = 1.0;
                     gaz[i][j][k] = 1.0;
@@ -420,12 +478,11 @@ public:
                     gby[i][j][k] = 0.0;
                     gbz[i][j][k] = 0.0;
 
-                    uint32_t index = IndexFromSimCoords(i, j, k);
-                    voxels[index].position = {i, j, k};
-                    voxels[index].color = utils::black;
+                    voxels.colors[IndexFromSimCoords(i, j, k)] = utils::black;
                 }
             }
         }
+        voxels.MarkAllChanged();
         for (int32_t n = 0; n < NFREQS; n++) {
             real_in[n] = 0.0;
             imag_in[n] = 0.0;
@@ -505,6 +562,7 @@ public:
         // here the original source code asks the user for for n_pml value,
         // we choose some dummy value
         n_pml = 2; // TODO what value should this be?
+        npml = n_pml;
         
         for ( i=0; i < n_pml; i++ ) {
             xxn = (npml-i)/npml;
@@ -565,104 +623,19 @@ public:
         }
 
 
-        /* Specify the dielectric sphere */
-
-        epsilon[0] = 1.;
-        sigma[0]   = 0;
-
-        // here the original source code asks the user for number of spheres
-        numsph = 2;
-
-        for ( i = ia; i < ib; i++ ) {
-            for ( j = ja; j < jb; j++ ) {
-                for ( k = ka; k < kb; k++ ) {
-                    eps = epsilon[0];
-                    cond = sigma[0];
-                    ydist = static_cast<double>(jc-j);
-                    xdist = static_cast<double>(ic-i-.5);
-                    zdist = static_cast<double>(kc-k);
-                    dist = sqrt(pow(xdist,2.) + pow(ydist,2.) + pow(zdist,2.));
-                    for (n=1; n<= numsph; n++) {
-                        if( dist <= radius[n]) {
-                            eps  =  epsilon[n];
-                            cond =  sigma[n] ;
-                        }
-                    }
-                    gax[i][j][k] = 1./(eps + (cond*dt/epsz));
-                    gbx[i][j][k] = cond*dt/epsz;
-                }
-            }
-        }
-
-        /* Calculate gax,gbx  */
-        for ( i = ia; i < ib; i++ ) {
-            for ( j = ja; j < jb; j++ ) {
-                for ( k = ka; k < kb; k++ ) {
-                    eps = epsilon[0];
-                    cond = sigma[0];
-                    ydist = (jc-j);
-                    xdist = (ic-i-.5);
-                    zdist = (kc-k);
-                    dist = sqrt(pow(xdist,2.) + pow(ydist,2.) + pow(zdist,2.));
-                    for (n=1; n<= numsph; n++) {
-                        if( dist <= radius[n]) {
-                            eps  =  epsilon[n];
-                            cond =  sigma[n] ;
-                        }
-                    }
-                    gax[i][j][k] = 1./(eps + (cond*dt/epsz));
-                    gbx[i][j][k] = cond*dt/epsz;
-                }
-            }
-        }
-        /* Calculate gay,gby  */
-        for ( i = ia; i < ib; i++ ) {
-            for ( j = ja; j < jb; j++ ) {
-                for ( k = ka; k < kb; k++ ) {
-                   eps = epsilon[0];
-                   cond = sigma[0];
-                   xdist = (ic-i);
-                   ydist = (jc-j-.5);
-                   zdist = (kc-k);
-                   dist = sqrt(pow(xdist,2.) + pow(ydist,2.) + pow(zdist,2.));
-                   for (n=1; n<= numsph; n++) {
-                       if( dist <= radius[n]) {
-                           eps  = epsilon[n] ;
-                           cond = sigma[n] ;
-                       }
-                   }
-                   gay[i][j][k] = 1./(eps + (cond*dt/epsz));
-                   gby[i][j][k] = cond*dt/epsz;
-                }
-            }
-        }
+        /* Specify the dielectric objects */
 
-        /* Calculate gaz,gbz  */
-        for ( i = ia; i < ib; i++ ) {
-            for ( j = ja; j < jb; j++ ) {
-                for ( k = ka; k < kb; k++ ) {
-                    eps = epsilon[0];
-                    cond = sigma[0];
-                    xdist = (ic-i);
-                    ydist = (jc-j);
-                    zdist = (kc-k-.5);
-                    dist = sqrt(pow(xdist,2.) + pow(ydist,2.) + pow(zdist,2.));
-                    for (n=1; n<= numsph; n++) {
-                        if( dist <= radius[n]) {
-                            eps  =  epsilon[n] ;
-                            cond =  sigma[n];
-                        }
-                    }
-                    gaz[i][j][k] = 1./(eps + (cond*dt/epsz));
-                    gbz[i][j][k] = cond*dt/epsz;
-                }
-            }
-        }
+        // each E component lives on its own half-cell staggered grid
+        SetMaterialCoefficients(scene.Voxelize(gridSize, {0.5, 0.0, 0.0}), gax, gbx);
+        SetMaterialCoefficients(scene.Voxelize(gridSize, {0.0, 0.5, 0.0}), gay, gby);
+        SetMaterialCoefficients(scene.Voxelize(gridSize, {0.0, 0.0, 0.5}), gaz, gbz);
+        ClassifyMaterials();
 
         t0 = 40.0;
         spread = 10.0;
         T = 0;
         nsteps = 1;
+        energy.Reset();
     }
 
     double Step(double _dt) override
@@ -845,15 +818,56 @@ public:
 
         /* Calculate the E from D field */
         /* Remember: part of the PML is E=0 at the edges */
-        for ( i=1; i < IE-1; i++ ) {
-            for ( j=1; j < JE-1; j++ ) {
-                for ( k=1; k < KE-1; k++ ) {
-                    ex[i][j][k] = gax[i][j][k]*(dx[i][j][k] - ix[i][j][k]);
-                    ix[i][j][k] = ix[i][j][k] + gbx[i][j][k]*ex[i][j][k];
-                    ey[i][j][k] = gay[i][j][k]*(dy[i][j][k] - iy[i][j][k]);
-                    iy[i][j][k] = iy[i][j][k] + gby[i][j][k]*ey[i][j][k];
-                    ez[i][j][k] = gaz[i][j][k]*(dz[i][j][k] - iz[i][j][k]);
-                    iz[i][j][k] = iz[i][j][k] + gbz[i][j][k]*ez[i][j][k];
+        /* Spans of cells with the same material class, see ClassifyMaterials() */
+        /* Field energy (E.D and H.H) is summed up in the update passes */
+        double e_energy = 0.0;
+        double h_energy = 0.0;
+        for (const auto& span : material_spans) {
+            auto ex_row = ex[span.i][span.j].data(), dx_row = dx[span.i][span.j].data();
+            auto ey_row = ey[span.i][span.j].data(), dy_row = dy[span.i][span.j].data();
+            auto ez_row = ez[span.i][span.j].data(), dz_row = dz[span.i][span.j].data();
+            switch (span.type) {
+                case MaterialClass::VACUUM: {
+                    // ga = 1, gb = 0
+                    for ( k=span.k_begin; k < span.k_end; k++ ) {
+                        ex_row[k] = dx_row[k];
+                        ey_row[k] = dy_row[k];
+                        ez_row[k] = dz_row[k];
+                        e_energy += dx_row[k]*dx_row[k] + dy_row[k]*dy_row[k] + dz_row[k]*dz_row[k];
+                    }
+                    break;
+                }
+                case MaterialClass::DIELECTRIC: {
+                    // gb = 0, the integrators stay zero
+                    auto gax_row = gax[span.i][span.j].data();
+                    auto gay_row = gay[span.i][span.j].data();
+                    auto gaz_row = gaz[span.i][span.j].data();
+                    for ( k=span.k_begin; k < span.k_end; k++ ) {
+                        ex_row[k] = gax_row[k]*dx_row[k];
+                        ey_row[k] = gay_row[k]*dy_row[k];
+                        ez_row[k] = gaz_row[k]*dz_row[k];
+                        e_energy += ex_row[k]*dx_row[k] + ey_row[k]*dy_row[k] + ez_row[k]*dz_row[k];
+                    }
+                    break;
+                }
+                case MaterialClass::LOSSY: {
+                    auto gax_row = gax[span.i][span.j].data(), gbx_row = gbx[span.i][span.j].data();
+                    auto gay_row = gay[span.i][span.j].data(), gby_row = gby[span.i][span.j].data();
+                    auto gaz_row = gaz[span.i][span.j].data(), gbz_row = gbz[span.i][span.j].data();
+                    // integrators are stored only for the lossy cells
+                    auto ix_span = ix.data() + span.offset - span.k_begin;
+                    auto iy_span = iy.data() + span.offset - span.k_begin;
+                    auto iz_span = iz.data() + span.offset - span.k_begin;
+                    for ( k=span.k_begin; k < span.k_end; k++ ) {
+                        ex_row[k] = gax_row[k]*(dx_row[k] - ix_span[k]);
+                        ix_span[k] = ix_span[k] + gbx_row[k]*ex_row[k];
+                        ey_row[k] = gay_row[k]*(dy_row[k] - iy_span[k]);
+                        iy_span[k] = iy_span[k] + gby_row[k]*ey_row[k];
+                        ez_row[k] = gaz_row[k]*(dz_row[k] - iz_span[k]);
+                        iz_span[k] = iz_span[k] + gbz_row[k]*ez_row[k];
+                        e_energy += ex_row[k]*dx_row[k] + ey_row[k]*dy_row[k] + ez_row[k]*dz_row[k];
+                    }
+                    break;
                 }
             }
         }
@@ -884,6 +898,7 @@ public:
                     ihxl[i][j][k] = ihxl[i][j][k]  + curl_e;
                     hx[i][j][k] = fj3[j]*fk3[k]*hx[i][j][k]
                                 + fj2[j]*fk2[k]*.5*( curl_e + fi1[i]*ihxl[i][j][k] );
+                    h_energy += hx[i][j][k]*hx[i][j][k];
                 }
             }
         }
@@ -895,6 +910,7 @@ public:
                              - ez[i][j+1][k] + ez[i][j][k]) ;
                     hx[i][j][k] = fj3[j]*fk3[k]*hx[i][j][k]
                                 + fj2[j]*fk2[k]*.5*curl_e ;
+                    h_energy += hx[i][j][k]*hx[i][j][k];
                 }
             }
         }
@@ -908,6 +924,7 @@ public:
                         ihxh[ixh][j][k] = ihxh[ixh][j][k]  + curl_e;
                         hx[i][j][k] = fj3[j]*fk3[k]*hx[i][j][k]
                                     + fj2[j]*fk2[k]*.5*( curl_e + fi1[i]*ihxh[ixh][j][k] );
+                        h_energy += hx[i][j][k]*hx[i][j][k];
                     }
                 }
         }
@@ -931,6 +948,7 @@ public:
                     ihyl[i][j][k] = ihyl[i][j][k] + curl_e ;
                     hy[i][j][k] = fi3[i]*fk3[k]*hy[i][j][k]
                                 + fi2[i]*fk3[k]*.5*( curl_e + fj1[j]*ihyl[i][j][k] );
+                    h_energy += hy[i][j][k]*hy[i][j][k];
                 }
             }
         }
@@ -942,6 +960,7 @@ public:
                              - ex[i][j][k+1] + ex[i][j][k]) ;
                     hy[i][j][k] = fi3[i]*fk3[k]*hy[i][j][k]
                                 + fi2[i]*fk3[k]*.5*curl_e ;
+                    h_energy += hy[i][j][k]*hy[i][j][k];
                 }
             }
         }
@@ -955,6 +974,7 @@ public:
                     ihyh[i][jyh][k] = ihyh[i][jyh][k] + curl_e ;
                     hy[i][j][k] = fi3[i]*fk3[k]*hy[i][j][k]
                                 + fi2[i]*fk3[k]*.5*( curl_e + fj1[j]*ihyh[i][jyh][k] );
+                    h_energy += hy[i][j][k]*hy[i][j][k];
                 }
             }
         }
@@ -978,6 +998,7 @@ public:
                     ihzl[i][j][k] = ihzl[i][j][k] + curl_e;
                     hz[i][j][k] = fi3[i]*fj3[j]*hz[i][j][k]
                                 + fi2[i]*fj2[j]*.5*( curl_e + fk1[k]*ihzl[i][j][k] );
+                    h_energy += hz[i][j][k]*hz[i][j][k];
                 }
             }
         }
@@ -989,6 +1010,7 @@ public:
                             -  ey[i+1][j][k] + ey[i][j][k] );
                     hz[i][j][k] = fi3[i]*fj3[j]*hz[i][j][k]
                                 + fi2[i]*fj2[j]*.5*curl_e ;
+                    h_energy += hz[i][j][k]*hz[i][j][k];
                 }
             }
         }
@@ -1002,43 +1024,325 @@ public:
                     ihzh[i][j][kzh] = ihzh[i][j][kzh] + curl_e;
                     hz[i][j][k] = fi3[i]*fj3[j]*hz[i][j][k]
                                 + fi2[i]*fj2[j]*.5*( curl_e + fk1[k]*ihzh[i][j][kzh] );
+                    h_energy += hz[i][j][k]*hz[i][j][k];
                 }
             }
         }
 
+        energy.Update(0.5*e_energy, 0.5*h_energy, PoyntingFlux());
+
+        if (probes) {
+            probes->Sample(static_cast<uint64_t>(T), [this](Field field, int32_t i, int32_t j, int32_t k) {
+                switch (field) {
+                    case Field::EX: return ex[i][j][k];
+                    case Field::EY: return ey[i][j][k];
+                    case Field::EZ: return ez[i][j][k];
+                    case Field::HX: return hx[i][j][k];
+                    case Field::HY: return hy[i][j][k];
+                    case Field::HZ: return hz[i][j][k];
+                }
+                return 0.0;
+            });
+        }
+
+        InvalidateColors();
+
         return dt; // TODO
     }
 
-    void VoxelToColor() {
+    void VoxelToColor() override {
         auto [rows, cols, stacks] = this->gridSize.elements;
+        size_t plane = static_cast<size_t>(rows) * cols;
+        if (this->slices.Any()) {
+            VoxelToColorSlices();
+            return;
+        }
+        // TODO try something else other than ez
+        // stacks are contiguous in the field but a whole plane apart in the voxels
+        std::vector<const double*> lines(plane);
         for (int32_t row = 0; row < rows; row++) {
             for (int32_t col = 0; col < cols; col++) {
-                for (int32_t stack = 0; stack < stacks; stack++) {
-                    // TODO try something else other than ez
-                    uint32_t index = IndexFromSimCoords(row, col, stack);
-                    this->voxels[index].color = FieldStrengthToColor(ez[row][col][stack]);
+                lines[row * cols + col] = ez[row][col].data();
+            }
+        }
+        colormap.Apply(this->voxels, lines, stacks, 1, plane, true);
+    }
+
+    // Only the selected planes, O(N^2) instead of O(N^3)
+    void VoxelToColorSlices() {
+        auto [rows, cols, stacks] = this->gridSize.elements;
+        size_t plane = static_cast<size_t>(rows) * cols;
+        auto [slice_row, slice_col, slice_stack] = this->slices.index;
+        std::vector<const double*> lines;
+        this->voxels.BeginFrame();
+        if (slice_row >= 0 && slice_row < rows) {
+            lines.resize(cols);
+            for (int32_t col = 0; col < cols; col++) {
+                lines[col] = ez[slice_row][col].data();
+            }
+            colormap.Append(this->voxels, lines, stacks, 1, plane, false, static_cast<size_t>(slice_row) * cols);
+        }
+        if (slice_col >= 0 && slice_col < cols) {
+            lines.resize(rows);
+            for (int32_t row = 0; row < rows; row++) {
+                lines[row] = ez[row][slice_col].data();
+            }
+            size_t appended = this->voxels.visible.size();
+            colormap.Append(this->voxels, lines, stacks, cols, plane, false, slice_col);
+            // the line where it crosses the row plane is in the visible list already
+            RemoveVisible(appended, slice_row, -1);
+        }
+        if (slice_stack >= 0 && slice_stack < stacks) {
+            // one value per line, the stack plane is strided in the field
+            lines.resize(plane);
+            for (int32_t row = 0; row < rows; row++) {
+                for (int32_t col = 0; col < cols; col++) {
+                    lines[row * cols + col] = &ez[row][col][slice_stack];
                 }
             }
+            size_t appended = this->voxels.visible.size();
+            colormap.Append(this->voxels, lines, 1, 1, 0, false, slice_stack * plane);
+            RemoveVisible(appended, slice_row, slice_col);
         }
     }
 
+    // Drops the visible voxels from first on that lie in the row or col plane
+    // (-1 for none), they were added with an earlier plane already
+    void RemoveVisible(size_t first, int32_t row, int32_t col) {
+        auto [rows, cols, stacks] = this->gridSize.elements;
+        size_t plane = static_cast<size_t>(rows) * cols;
+        auto& visible = this->voxels.visible;
+        auto end = std::remove_if(visible.begin() + first, visible.end(), [&](uint32_t index) {
+            auto cell = static_cast<int32_t>(index % plane);
+            return cell / cols == row || cell % cols == col;
+        });
+        visible.erase(end, visible.end());
+    }
+
+    void SetSlices(const Slices& new_slices) override
+    {
+        BaseSimulation::SetSlices(new_slices);
+        InvalidateColors();
+    }
+
+    void CyclePalette() override
+    {
+        colormap.SetPalette(NextPalette(colormap.GetPalette()));
+        Log::info("Colormap: ", PaletteName(colormap.GetPalette()));
+        InvalidateColors();
+    }
+
     void TriggerSource() override {
       sourceAmplification = sourceAmplification > 0.01 ? 0.0 : 1.0;
     }
 
+    // Probes are sampled at the end of every step,
+    // fields that the simulation does not have read as zero
+    void AttachProbes(std::unique_ptr<Probes> new_probes)
+    {
+        new_probes->Validate(gridSize);
+        probes = std::move(new_probes);
+    }
+
+    const EnergyMonitor& GetEnergyMonitor() const { return energy; }
+
+    // Stop once the energy falls to this fraction of its peak, 0 = never
+    void SetStopThreshold(double relative) { energy.SetStopThreshold(relative); }
+
+    bool Finished() const override { return energy.Converged(); }
+
+    // The state is copied and written in the background, the simulation goes on
+    bool SaveCheckpoint(const std::string& filename) override
+    {
+        auto& state = checkpoint_writer.Staging();
+        state.clear();
+        VisitState([&](double* data, size_t count) {
+            state.insert(state.end(), data, data + count);
+        });
+        checkpoint_writer.WriteAsync(filename, MakeCheckpointHeader());
+        return true;
+    }
+
+    // Has to be loaded into a simulation of the same size and materials
+    bool LoadCheckpoint(const std::string& filename) override
+    {
+        // a checkpoint saved just before may still be being written
+        checkpoint_writer.Wait();
+        CheckpointHeader header;
+        std::vector<double> state;
+        if (!ReadCheckpoint(filename, header, state)) {
+            return false;
+        }
+        auto expected = MakeCheckpointHeader();
+        if (!std::equal(header.grid, header.grid + 3, expected.grid) ||
+            header.materials_hash != expected.materials_hash) {
+            Log::error("Checkpoint ", filename, " was saved with different grid or materials");
+            return false;
+        }
+        size_t state_size = 0;
+        VisitState([&](double*, size_t count) { state_size += count; });
+        if (state.size() != state_size) {
+            Log::error("Checkpoint ", filename, " has wrong size");
+            return false;
+        }
+        size_t pos = 0;
+        VisitState([&](double* data, size_t count) {
+            std::copy_n(state.data() + pos, count, data);
+            pos += count;
+        });
+        // the energy history belongs to the run before, it starts over from the loaded fields
+        energy.Reset();
+        InvalidateColors();
+        Log::info("Loaded checkpoint ", filename, ", T = ", T);
+        return true;
+    }
+
 
 private:
 
-    std::vector<
-        std::vector<
-            std::vector<
-                double
-            >
-        >
-    > dx, dy, dz,
+    using Field3D = std::vector<std::vector<std::vector<double>>>;
+
+    // ga = 1/(eps + sigma*dt/eps0), gb = sigma*dt/eps0, only inside of the PML
+    void SetMaterialCoefficients(const Geometry::MaterialGrid& materials, Field3D& ga, Field3D& gb)
+    {
+        utils::ParallelFor(ib - ia, [&](size_t row) {
+            int32_t i = ia + static_cast<int32_t>(row);
+            for (int32_t j = ja; j < jb; j++) {
+                for (int32_t k = ka; k < kb; k++) {
+                    const auto& material = scene.GetMaterial(materials.At(i, j, k));
+                    double cond_term = material.sigma * dt / epsz;
+                    ga[i][j][k] = 1. / (material.epsilon + cond_term);
+                    gb[i][j][k] = cond_term;
+                }
+            }
+        });
+    }
+
+    enum class MaterialClass : uint8_t {
+        VACUUM,     // ga = 1, gb = 0
+        DIELECTRIC, // gb = 0
+        LOSSY,      // gb != 0, needs the ix/iy/iz integrators
+    };
+
+    // cells [k_begin, k_end) of row (i,j) share the material class
+    struct MaterialSpan {
+        int32_t i, j;
+        int32_t k_begin, k_end;
+        MaterialClass type;
+        uint32_t offset; // into ix/iy/iz, LOSSY spans only
+    };
+
+    // Splits the E from D update region into spans by material class, so that
+    // the update skips the coefficient loads and integrators where not needed
+    void ClassifyMaterials()
+    {
+        material_spans.clear();
+        uint32_t lossy_cells = 0;
+        for (int32_t si = 1; si < IE-1; si++) {
+            for (int32_t sj = 1; sj < JE-1; sj++) {
+                for (int32_t sk = 1; sk < KE-1; sk++) {
+                    MaterialClass type = MaterialClass::VACUUM;
+                    if (gbx[si][sj][sk] != 0.0 || gby[si][sj][sk] != 0.0 || gbz[si][sj][sk] != 0.0) {
+                        type = MaterialClass::LOSSY;
+                    } else if (gax[si][sj][sk] != 1.0 || gay[si][sj][sk] != 1.0 || gaz[si][sj][sk] != 1.0) {
+                        type = MaterialClass::DIELECTRIC;
+                    }
+                    if (sk > 1 && material_spans.back().type == type) {
+                        material_spans.back().k_end++;
+                    } else {
+                        material_spans.push_back({si, sj, sk, sk + 1, type, lossy_cells});
+                    }
+                    if (type == MaterialClass::LOSSY) {
+                        lossy_cells++;
+                    }
+                }
+            }
+        }
+        ix.assign(lossy_cells, 0.0);
+        iy.assign(lossy_cells, 0.0);
+        iz.assign(lossy_cells, 0.0);
+        Log::debug("FDTD_3D: ", material_spans.size(), " material spans, ",
+                   lossy_cells, " lossy cells");
+    }
+
+    // Calls f(data, count) for every contiguous chunk of the simulation state
+    // (fields, PML, incident buffer and Fourier accumulators), always in the same order
+    template<class F>
+    void VisitState(F&& f)
+    {
+        auto visit_3D = [&](Field3D& field) {
+            for (auto& plane : field) {
+                for (auto& row : plane) {
+                    f(row.data(), row.size());
+                }
+            }
+        };
+        for (auto* field : {&dx, &dy, &dz, &ex, &ey, &ez, &hx, &hy, &hz,
+                            &idxl, &idxh, &ihxl, &ihxh, &idyl, &idyh,
+                            &ihyl, &ihyh, &idzl, &idzh, &ihzl, &ihzh,
+                            &real_pt, &imag_pt}) {
+            visit_3D(*field);
+        }
+        for (auto* field : {&ix, &iy, &iz, &ez_inc, &hx_inc}) {
+            f(field->data(), field->size());
+        }
+        for (auto* value : {&ez_low_m1, &ez_low_m2, &ez_high_m1, &ez_high_m2,
+                            &T, &sourceAmplification}) {
+            f(value, 1);
+        }
+        f(real_in, NFREQS);
+        f(imag_in, NFREQS);
+    }
+
+    CheckpointHeader MakeCheckpointHeader()
+    {
+        CheckpointHeader header;
+        std::copy_n(gridSize.elements.begin(), 3, header.grid);
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (auto* field : {&gax, &gay, &gaz, &gbx, &gby, &gbz}) {
+            for (auto& plane : *field) {
+                for (auto& row : plane) {
+                    hash = HashDoubles(hash, row.data(), row.size());
+                }
+            }
+        }
+        header.materials_hash = hash;
+        return header;
+    }
+
+    // Outgoing E x H through the faces of the total field box, surface only
+    double PoyntingFlux()
+    {
+        double flux = 0.0;
+        for (int32_t sj = ja; sj <= jb; sj++) {
+            for (int32_t sk = ka; sk <= kb; sk++) {
+                flux += ey[ib][sj][sk]*hz[ib][sj][sk] - ez[ib][sj][sk]*hy[ib][sj][sk];
+                flux -= ey[ia][sj][sk]*hz[ia][sj][sk] - ez[ia][sj][sk]*hy[ia][sj][sk];
+            }
+        }
+        for (int32_t si = ia; si <= ib; si++) {
+            for (int32_t sk = ka; sk <= kb; sk++) {
+                flux += ez[si][jb][sk]*hx[si][jb][sk] - ex[si][jb][sk]*hz[si][jb][sk];
+                flux -= ez[si][ja][sk]*hx[si][ja][sk] - ex[si][ja][sk]*hz[si][ja][sk];
+            }
+            for (int32_t sj = ja; sj <= jb; sj++) {
+                flux += ex[si][sj][kb]*hy[si][sj][kb] - ey[si][sj][kb]*hx[si][sj][kb];
+                flux -= ex[si][sj][ka]*hy[si][sj][ka] - ey[si][sj][ka]*hx[si][sj][ka];
+            }
+        }
+        return flux;
+    }
+
+    EnergyMonitor energy;
+    CheckpointWriter checkpoint_writer;
+
+    Geometry::Scene scene;
+    std::vector<MaterialSpan> material_spans;
+    std::vector<double> ix, iy, iz; // only for LOSSY cells
+
+    Field3D dx, dy, dz,
       ex, ey, ez,
       hx, hy, hz,
-      ix, iy, iz,
       gax, gay, gaz,
       gbx, gby, gbz,
       //
@@ -1078,9 +1382,6 @@ private:
     int ixh, jyh, kzh;
     int NSTEPS;
     double curl_h,curl_d;
-    double radius[10],epsilon[10],sigma[10],eps,cond;
-    int numsph;
-    double dist,xdist,ydist,zdist;
 
     static constexpr int NFREQS = 3;
     double freq[NFREQS],arg[NFREQS];
@@ -1088,6 +1389,9 @@ private:
 
     double sourceAmplification = 1.0;
 
+    std::unique_ptr<Probes> probes;
+    Colormap colormap;
+
 };
 
 
@@ -0,0 +1,124 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "log.hpp"
+#include "simulations/fdtd_ensemble.hpp"
+
+namespace Simulation {
+
+FDTD_1D_Ensemble::FDTD_1D_Ensemble(uint32_t cells, std::vector<FDTD_1D_Case> cases) :
+    KE(static_cast<int32_t>(cells)),
+    cases(std::move(cases))
+{
+    dx = 0.01;                          // Cell size [m]
+    dt = dx/(2*utils::constants::C0);   // Time step [s]
+
+    for (auto& c : this->cases) {
+        if (c.slab_end < 0) {
+            c.slab_end = KE;
+        }
+        if (c.source <= 0 || c.source >= KE - 1 || c.probe < 0 || c.probe >= KE ||
+            c.slab_start < 0 || c.slab_end > KE) {
+            Log::critical("FDTD_1D_Ensemble: case does not fit the grid of ", KE, " cells");
+            throw std::out_of_range("Wrong FDTD_1D case");
+        }
+    }
+}
+
+FDTD_1D_EnsembleResult FDTD_1D_Ensemble::Run(uint32_t steps, uint32_t record_every) const
+{
+    record_every = std::max(record_every, 1u);
+    FDTD_1D_EnsembleResult result;
+    result.samples = steps / record_every;
+    result.probe.resize(this->cases.size() * result.samples);
+    result.peak.resize(this->cases.size());
+
+    size_t groups = (this->cases.size() + LANES - 1) / LANES;
+    utils::ParallelFor(groups, [&](size_t group) {
+        RunGroup(group, steps, record_every, result);
+    });
+    return result;
+}
+
+void FDTD_1D_Ensemble::RunGroup(size_t group, uint32_t steps, uint32_t record_every,
+                                FDTD_1D_EnsembleResult& result) const
+{
+    // the last group is padded with copies of its first case
+    size_t first = group * LANES;
+    size_t active = std::min<size_t>(LANES, this->cases.size() - first);
+    FDTD_1D_Case lane_case[LANES];
+    for (int l = 0; l < LANES; l++) {
+        lane_case[l] = this->cases[first + (l < static_cast<int>(active) ? l : 0)];
+    }
+
+    std::vector<Lanes> ex(KE), hy(KE), cb(KE);
+    for (int k = 0; k < KE; k++) {
+        for (int l = 0; l < LANES; l++) {
+            ex[k].v[l] = 0.0;
+            hy[k].v[l] = 0.0;
+            bool in_slab = k >= lane_case[l].slab_start && k < lane_case[l].slab_end;
+            cb[k].v[l] = in_slab ? 1.0/lane_case[l].epsilon : 1.0;
+        }
+    }
+
+    // Temp variables for absorbing boundaries
+    Lanes ex_low_1{}, ex_low_2{};
+    Lanes ex_high_1{}, ex_high_2{}, ex_high_3{}, ex_high_4{};
+    double peak[LANES] = {};
+
+    for (uint32_t step = 1; step <= steps; step++) {
+        double T = step;
+
+        // Calculate the Ex field
+        for (int k = 1; k < KE; k++) {
+            for (int l = 0; l < LANES; l++) {
+                ex[k].v[l] += cb[k].v[l]*0.5*( hy[k-1].v[l] - hy[k].v[l] );
+            }
+        }
+
+        // Gaussian pulse, each lane has its own
+        for (int l = 0; l < LANES; l++) {
+            const auto& c = lane_case[l];
+            double carrier = sin(2.0*M_PI*c.freq_in*dt*T);
+            double enveloppe = exp( -0.5*pow((c.t0-T)/c.spread, 2.0) );
+            ex[c.source].v[l] += carrier*enveloppe;
+        }
+
+        // Absorbing boundary conditions for Ex
+        for (int l = 0; l < LANES; l++) {
+            ex[0].v[l]       = ex_low_2.v[l];
+            ex_low_2.v[l]    = ex_low_1.v[l];
+            ex_low_1.v[l]    = ex[1].v[l];
+
+            ex[KE-1].v[l]    = ex_high_4.v[l];
+            ex_high_4.v[l]   = ex_high_3.v[l];
+            ex_high_3.v[l]   = ex_high_2.v[l];
+            ex_high_2.v[l]   = ex_high_1.v[l];
+            ex_high_1.v[l]   = ex[KE-2].v[l];
+        }
+
+        // Calculate the Hy field
+        for (int k = 0; k < KE-1; k++) {
+            for (int l = 0; l < LANES; l++) {
+                hy[k].v[l] += 0.5*( ex[k].v[l] - ex[k+1].v[l] );
+            }
+        }
+
+        // Probes
+        for (int l = 0; l < LANES; l++) {
+            peak[l] = std::max(peak[l], std::abs(ex[lane_case[l].probe].v[l]));
+        }
+        if (step % record_every == 0) {
+            size_t sample = step / record_every - 1;
+            for (size_t l = 0; l < active; l++) {
+                result.probe[(first + l) * result.samples + sample] = ex[lane_case[l].probe].v[l];
+            }
+        }
+    }
+
+    for (size_t l = 0; l < active; l++) {
+        result.peak[first + l] = peak[l];
+    }
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "utilities.hpp"
+
+namespace Simulation {
+
+/**
+ * One configuration of the FDTD_1D problem: a dielectric slab hit by a
+ * sine-modulated gaussian pulse
+ */
+struct FDTD_1D_Case {
+    double epsilon = 4.0;   // relative dielectric constant of the slab
+    int32_t slab_start = 0; // first cell of the slab
+    int32_t slab_end = -1;  // one past the last cell, -1 = end of the grid
+    double t0 = 80.0;       // center of the incident pulse [steps]
+    double spread = 40.0;   // width of the incident pulse [steps]
+    double freq_in = 2.0e9; // signal frequency [Hz]
+    int32_t source = 5;     // cell where the pulse is injected
+    int32_t probe = 0;      // cell whose Ex is recorded
+};
+
+struct FDTD_1D_EnsembleResult {
+    uint32_t samples = 0;       // recorded samples per case
+    std::vector<double> probe;  // Ex at the probe, [case * samples + sample]
+    std::vector<double> peak;   // max |Ex| at the probe, per case
+
+    const double* Series(size_t case_index) const { return &probe[case_index * samples]; }
+};
+
+/**
+ * Runs many independent FDTD_1D configurations in lockstep.
+ *
+ * Cases are interleaved in groups of LANES (field[cell][lane]), so
+ * the update loops over lanes vectorize, and the groups are spread
+ * over all hardware threads. All cases share the grid size and dx.
+ */
+class FDTD_1D_Ensemble {
+public:
+    static constexpr int LANES = 8;
+
+    FDTD_1D_Ensemble(uint32_t cells, std::vector<FDTD_1D_Case> cases);
+
+    // Ex at every case's probe is recorded every record_every steps
+    FDTD_1D_EnsembleResult Run(uint32_t steps, uint32_t record_every = 1) const;
+
+private:
+    struct alignas(64) Lanes {
+        double v[LANES];
+    };
+
+    int32_t KE;
+    double dx, dt;
+    std::vector<FDTD_1D_Case> cases;
+
+    void RunGroup(size_t group, uint32_t steps, uint32_t record_every,
+                  FDTD_1D_EnsembleResult& result) const;
+};
+
+}
@@ -0,0 +1,98 @@
+#include <cmath>
+#include <cassert>
+#include <fstream>
+#include <filesystem>
+
+#include "simulations/fdtd_ensemble.hpp"
+#include "simulations/fdtd.hpp"
+#include "log.hpp"
+
+using namespace Simulation;
+
+template<class T>
+T read(std::ifstream& file)
+{
+    T value;
+    file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+// Ex series of a single point probe, in step order
+std::vector<double> read_probe(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    file.seekg(8 + 2 * sizeof(uint32_t));
+    auto length = read<uint32_t>(file);
+    file.seekg(length + 2 * sizeof(uint32_t) + 6 * sizeof(int32_t) + sizeof(uint32_t), std::ios::cur);
+    std::vector<double> series;
+    while (true) {
+        read<uint32_t>(file);
+        auto count = read<uint32_t>(file);
+        if (!file) {
+            return series;
+        }
+        file.seekg(sizeof(uint64_t) * count, std::ios::cur);
+        for (uint32_t s = 0; s < count; s++) {
+            series.push_back(read<double>(file));
+        }
+    }
+}
+
+int main(void)
+{
+    constexpr uint32_t cells = 200;
+    constexpr uint32_t steps = 400;
+    auto filename = (std::filesystem::temp_directory_path() / "fdtd_ensemble_test.probe").string();
+
+    // more cases than a group of lanes, so the last group is padded
+    std::vector<FDTD_1D_Case> cases;
+    for (int i = 0; i < FDTD_1D_Ensemble::LANES + 3; i++) {
+        FDTD_1D_Case c;
+        c.epsilon = 1.0 + 0.5 * i;
+        c.slab_start = 60 + 5 * i;
+        c.slab_end = i % 2 ? -1 : 150 + i;
+        c.t0 = 60.0 + 4.0 * i;
+        c.spread = 20.0 + 2.0 * i;
+        c.freq_in = 1.0e9 + 0.2e9 * i;
+        c.source = 5 + i;
+        c.probe = 30 + 7 * i;
+        cases.push_back(c);
+    }
+    FDTD_1D_Ensemble ensemble(cells, cases);
+    auto result = ensemble.Run(steps);
+    assert(result.samples == steps);
+
+    // every lane matches a scalar FDTD_1D run of its case bit for bit
+    for (size_t i = 0; i < cases.size(); i++) {
+        {
+            FDTD_1D scalar(cells, cases[i]);
+            int32_t probe = cases[i].probe;
+            scalar.AttachProbes(std::make_unique<Probes>(filename,
+                std::vector<ProbeSpec>{{"probe", Field::EX, {probe, 0, 0}, {probe, 0, 0}}}, 64));
+            for (uint32_t step = 0; step < steps; step++) {
+                scalar.Step(0.0);
+            }
+        }
+        auto series = read_probe(filename);
+        assert(series.size() == steps);
+        double peak = 0.0;
+        for (uint32_t s = 0; s < steps; s++) {
+            assert(series[s] == result.Series(i)[s]);
+            peak = std::max(peak, std::abs(series[s]));
+        }
+        assert(peak == result.peak[i]);
+        assert(peak > 0.0);
+    }
+
+    // recording every Nth step picks the same samples
+    auto sparse = ensemble.Run(steps, 7);
+    assert(sparse.samples == steps / 7);
+    for (size_t i = 0; i < cases.size(); i++) {
+        for (uint32_t s = 0; s < sparse.samples; s++) {
+            assert(sparse.Series(i)[s] == result.Series(i)[(s + 1) * 7 - 1]);
+        }
+    }
+
+    std::filesystem::remove(filename);
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include <random>
+#include <algorithm>
 
 #include "utilities.hpp"
 #include "simulations/game_of_life_3D.hpp"
@@ -19,17 +20,8 @@ GameOfLife3D::GameOfLife3D(uint32_t rows, uint32_t cols, uint32_t stacks) :
     auto size = rows * cols * stacks;
     this->cells_current.resize(size);
     this->cells_next.resize(size);
-
-    for (int32_t row = 0; row < static_cast<int32_t>(rows); row++) {
-        for (int32_t col = 0; col < static_cast<int32_t>(cols); col++) {
-            for (int32_t stack = 0; stack < static_cast<int32_t>(stacks); stack++) {
-                uint32_t index = IndexFromSimCoords(row, col, stack);
-                this->voxels[index].color = black;
-                this->voxels[index].position = { row, col, stack };
-
-            }
-        }
-    }
+    std::fill(this->voxels.colors.begin(), this->voxels.colors.end(), black);
+    this->voxels.MarkAllChanged();
     this->InitRandomState();
 }
 
@@ -45,13 +37,14 @@ void GameOfLife3D::InitRandomState() {
     
     this->simulation_time = 0.0;
 
-    VoxelToColor();
+    InvalidateColors();
 }
 
 void GameOfLife3D::VoxelToColor() {
     auto [rows, cols, stacks] = this->gridSize.elements;
+    this->voxels.BeginFrame();
     for (int index = 0; index < rows * cols * stacks; ++index) {
-        this->voxels[index].color = this->cells_current[index] ? white : transparent;
+        this->voxels.SetColor(index, this->cells_current[index] ? white : transparent);
     }   
 }
 
@@ -75,7 +68,7 @@ double GameOfLife3D::Step(double dt) {
     }
     std::swap(this->cells_current, this->cells_next);
 
-    VoxelToColor();
+    InvalidateColors();
 
     this->simulation_time += dt;
     return dt;
@@ -1,43 +1,26 @@
 #pragma once
 
 #include <iostream>
-#include <fstream>
 
 #include "log.hpp"
 #include "simulations/base.hpp"
+#include "simulations/sim_file.hpp"
 
 namespace Simulation {
 
 class Playback : public BaseSimulation
 {
 public:
-    Playback(std::string filename)
+    Playback(std::string filename) :
+        m_Reader(filename)
     {
-        m_File = std::ifstream(filename);
-        if (!m_File.is_open()) {
-            Log::critical("Failed to open playback file ", filename);
-            throw std::runtime_error("Failed to open file");
-        }
         Log::info("Opened file ", filename, " for playback");
-        LoadHeader();
+        this->gridSize = m_Reader.Size();
         ResizeVoxels();
 
-        auto [rows, cols, stacks] = gridSize.elements;
-        for (int32_t row = 0; row < static_cast<int32_t>(rows); row++) {
-            for (int32_t col = 0; col < static_cast<int32_t>(cols); col++) {
-                for (int32_t stack = 0; stack < static_cast<int32_t>(stacks); stack++) {
-                    uint32_t index = IndexFromSimCoords(row, col, stack);
-                    this->voxels[index].color = utils::black;
-                    this->voxels[index].position = { row, col, stack };
-                }
-            }
-        }
-
-    }
+        std::fill(voxels.colors.begin(), voxels.colors.end(), utils::black);
+        voxels.MarkAllChanged();
 
-    ~Playback()
-    {
-        m_File.close();
     }
 
     void InitRandomState()
@@ -47,70 +30,76 @@ public:
 
     double Step(double dt)
     {
-        double actual_dt = LoadStep();
-        simulation_time += actual_dt;
+        if (m_Reverse) {
+            uint64_t current = CurrentStep();
+            if (current == 0 || !SeekStep(current - 1)) {
+                return 0.0;
+            }
+            return m_Reader.Time(current) - m_Reader.Time(current - 1);
+        }
+        double actual_dt;
+        if (!m_Reader.ReadFrame(actual_dt)) {
+            // nothing more to load or other error
+            return 0.0;
+        }
+        ShowFrame();
         return actual_dt;
     }
 
-private:
-    std::ifstream m_File;
+    // Past the last recorded step (or the first one, backwards)
+    bool Finished() const override
+    {
+        return m_Reverse ? CurrentStep() == 0 : m_Reader.AtEnd();
+    }
 
-    void LoadHeader()
+    uint64_t StepCount() const override
     {
-        uint32_t rows, cols, stacks;
-        m_File.read(reinterpret_cast<char*>(&rows), sizeof(rows));
-        m_File.read(reinterpret_cast<char*>(&cols), sizeof(cols));
-        m_File.read(reinterpret_cast<char*>(&stacks), sizeof(stacks));
-        if (m_File.fail()) {
-            const char* msg = "Failed to read sim dimensions from file";
-            Log::critical(msg);
-            throw std::runtime_error(msg);
-        }
-        Log::info("Playback sim dimensions: ",
-                rows, " ", cols, " ", stacks
-        );
-        constexpr uint32_t MAX = 4096;
-        assert(rows < MAX && cols < MAX && stacks < MAX);
-        this->gridSize.elements[0] = rows;
-        this->gridSize.elements[1] = cols;
-        this->gridSize.elements[2] = stacks;
+        return m_Reader.Count();
     }
 
-    double LoadStep()
+    uint64_t CurrentStep() const override
     {
-        double dt;
+        return m_Reader.Position() == 0 ? 0 : m_Reader.Position() - 1;
+    }
 
-        m_File.read(reinterpret_cast<char*>(&dt), sizeof(dt));
-        if (m_File.fail()) {
-            // nothing more to load or other error
-            return 0.0;
+    // Decodes from the keyframe before the step, at most SimWriter::KEYFRAME_INTERVAL steps
+    bool SeekStep(uint64_t step) override
+    {
+        if (!m_Reader.Seek(step)) {
+            return false;
         }
+        ShowFrame();
+        return true;
+    }
+
+    bool SetReverse(bool reverse) override
+    {
+        m_Reverse = reverse;
+        Log::info(reverse ? "Playing backwards" : "Playing forwards");
+        return true;
+    }
+
+private:
+    SimReader m_Reader;
+    bool m_Reverse = false;
+
+    void ShowFrame()
+    {
+        simulation_time = m_Reader.Time(CurrentStep());
         auto [ rows, cols, stacks ] = this->gridSize.elements;
-        for (auto row = 0; row < rows; row++) {
-            for (auto col = 0; col < cols; col++) {
-                for (auto stack = 0; stack < stacks; stack++) {
-                    uint8_t R, G, B, A;
-                    m_File.read(reinterpret_cast<char*>(&R), 1);
-                    m_File.read(reinterpret_cast<char*>(&G), 1);
-                    m_File.read(reinterpret_cast<char*>(&B), 1);
-                    m_File.read(reinterpret_cast<char*>(&A), 1);
-                    if (m_File.fail()) {
-                        // nothing more to load or other error
-                        Log::info("Nothing more to load (or some error)");
-                        return 0.0;
-                    }
-                    auto index = IndexFromSimCoords(row, col, stack);
-                    auto& voxel = voxels[index];
-                    voxel.color[0] = R;
-                    voxel.color[1] = G;
-                    voxel.color[2] = B;
-                    voxel.color[3] = A;
+        const utils::Color* frame = m_Reader.Frame();
+        // transposed into the voxel order, which keeps the visible list sorted
+        voxels.BeginFrame();
+        uint32_t index = 0;
+        for (int32_t stack = 0; stack < stacks; stack++) {
+            for (int32_t row = 0; row < rows; row++) {
+                const utils::Color* line = &frame[static_cast<size_t>(row) * cols * stacks + stack];
+                for (int32_t col = 0; col < cols; col++) {
+                    voxels.SetColor(index++, line[static_cast<size_t>(col) * stacks]);
                 }
             }
         }
-        Log::info("Loaded step");
-
-        return dt;
+        Log::debug("Loaded step");
     }
 };
 
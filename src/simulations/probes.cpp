@@ -0,0 +1,177 @@
+#include <stdexcept>
+
+#include "simulations/probes.hpp"
+
+namespace Simulation {
+
+// blocks per probe, writer can lag behind by this many blocks
+constexpr size_t BLOCKS_PER_PROBE = 4;
+
+namespace {
+
+// Boxes no grid can hold, checked before the blocks are sized by them
+// (Validate checks the rest once the grid is known)
+void CheckBox(const ProbeSpec& spec)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        if (spec.from[axis] < 0 || spec.from[axis] > spec.to[axis]) {
+            Log::critical("Probe ", spec.name, " has wrong coordinates ", spec.from, " to ", spec.to);
+            throw std::out_of_range("Wrong probe coordinates");
+        }
+    }
+}
+
+}
+
+Probes::Probes(std::string filename, std::vector<ProbeSpec> specs, uint32_t samples_per_block) :
+    samples_per_block(samples_per_block)
+{
+    for (const auto& spec : specs) {
+        CheckBox(spec);
+    }
+    m_File = std::ofstream(filename, std::ios::binary);
+    if (!m_File.is_open()) {
+        Log::critical("Failed to open probe file ", filename);
+        throw std::runtime_error("Failed to open file");
+    }
+
+    this->probes.resize(specs.size());
+    for (size_t p = 0; p < specs.size(); p++) {
+        auto& probe = this->probes[p];
+        probe.spec = std::move(specs[p]);
+        probe.index = static_cast<uint32_t>(p);
+        probe.points = 1;
+        for (int axis = 0; axis < 3; axis++) {
+            probe.points *= static_cast<uint32_t>(probe.spec.to[axis] - probe.spec.from[axis] + 1);
+        }
+        probe.spec.every = std::max(probe.spec.every, 1u);
+        probe.blocks.resize(BLOCKS_PER_PROBE);
+        for (auto& block : probe.blocks) {
+            block.steps.resize(samples_per_block);
+            block.values.resize(static_cast<size_t>(samples_per_block) * probe.points);
+            probe.free.push_back(&block);
+        }
+    }
+    SaveHeader();
+    Log::info("Recording ", this->probes.size(), " probes to file ", filename);
+
+    this->writer = std::thread(&Probes::WriterLoop, this);
+}
+
+Probes::~Probes()
+{
+    Flush();
+    {
+        std::lock_guard lock(this->mutex);
+        this->exit_requested = true;
+    }
+    this->cv.notify_all();
+    this->writer.join();
+    m_File.close();
+}
+
+void Probes::Validate(const utils::Vec<int32_t, 3>& grid_size) const
+{
+    for (const auto& probe : this->probes) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (probe.spec.from[axis] < 0 || probe.spec.from[axis] > probe.spec.to[axis] ||
+                probe.spec.to[axis] >= grid_size[axis]) {
+                Log::critical("Probe ", probe.spec.name, " does not fit the grid ", grid_size);
+                throw std::out_of_range("Wrong probe coordinates");
+            }
+        }
+    }
+}
+
+void Probes::Flush()
+{
+    for (auto& probe : this->probes) {
+        if (probe.current != nullptr && probe.current->count > 0) {
+            SubmitBlock(probe);
+        }
+    }
+}
+
+Probes::Block* Probes::AcquireBlock(Probe& probe)
+{
+    std::unique_lock lock(this->mutex);
+    if (probe.free.empty()) {
+        Log::warning("Probe writer can't keep up, waiting");
+        this->cv.wait(lock, [&] { return !probe.free.empty(); });
+    }
+    auto* block = probe.free.back();
+    probe.free.pop_back();
+    block->count = 0;
+    return block;
+}
+
+void Probes::SubmitBlock(Probe& probe)
+{
+    {
+        std::lock_guard lock(this->mutex);
+        this->queue.push_back({&probe, probe.current});
+    }
+    probe.current = nullptr;
+    this->cv.notify_all();
+}
+
+void Probes::SaveHeader()
+{
+    auto write = [this](const auto& value) {
+        m_File.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    m_File.write("G3LPROBE", 8);
+    write(VERSION);
+    write(static_cast<uint32_t>(this->probes.size()));
+    for (const auto& probe : this->probes) {
+        write(static_cast<uint32_t>(probe.spec.name.size()));
+        m_File.write(probe.spec.name.data(), probe.spec.name.size());
+        write(probe.spec.field);
+        write(probe.spec.from.elements);
+        write(probe.spec.to.elements);
+        write(probe.spec.every);
+        write(probe.points);
+    }
+}
+
+void Probes::WriterLoop()
+{
+    std::vector<double> columns;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(this->mutex);
+            this->cv.wait(lock, [this] { return this->exit_requested || !this->queue.empty(); });
+            if (this->queue.empty()) {
+                return;
+            }
+            job = this->queue.front();
+            this->queue.pop_front();
+        }
+
+        auto& block = *job.block;
+        auto points = job.probe->points;
+        auto count = block.count;
+        columns.resize(static_cast<size_t>(count) * points);
+        for (uint32_t s = 0; s < count; s++) {
+            for (uint32_t p = 0; p < points; p++) {
+                columns[static_cast<size_t>(p) * count + s] = block.values[static_cast<size_t>(s) * points + p];
+            }
+        }
+        m_File.write(reinterpret_cast<const char*>(&job.probe->index), sizeof(uint32_t));
+        m_File.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        m_File.write(reinterpret_cast<const char*>(block.steps.data()), sizeof(uint64_t) * count);
+        m_File.write(reinterpret_cast<const char*>(columns.data()), sizeof(double) * columns.size());
+        if (m_File.fail()) {
+            Log::error("Failed to write probe data");
+        }
+
+        {
+            std::lock_guard lock(this->mutex);
+            job.probe->free.push_back(job.block);
+        }
+        this->cv.notify_all();
+    }
+}
+
+}
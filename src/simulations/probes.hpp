@@ -0,0 +1,127 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <condition_variable>
+
+#include "log.hpp"
+#include "utilities.hpp"
+
+namespace Simulation {
+
+enum class Field : uint32_t { EX = 0, EY, EZ, HX, HY, HZ };
+
+/**
+ * Samples a field in a box of cells (inclusive). Point, line or plane
+ * probes are boxes with some of the dimensions collapsed (from == to).
+ */
+struct ProbeSpec {
+    std::string name;
+    Field field;
+    utils::SimCoords from;
+    utils::SimCoords to;
+    uint32_t every = 1; // sample every N steps
+};
+
+/**
+ * Time-series recording of a few field probes, a cheap alternative
+ * to recording whole frames with Recorder.
+ *
+ * Samples are stored into preallocated blocks, full blocks are
+ * transposed and written by a background thread. File layout:
+ *
+ *   header: "G3LPROBE", uint32 version, uint32 probe count,
+ *           per probe: uint32 name length, name, uint32 field,
+ *           int32 from[3], int32 to[3], uint32 every, uint32 points
+ *   blocks: uint32 probe index, uint32 sample count n,
+ *           uint64 step[n], per point: double value[n] (columnar)
+ */
+class Probes {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    Probes(std::string filename, std::vector<ProbeSpec> specs, uint32_t samples_per_block = 1024);
+    ~Probes();
+
+    Probes(const Probes&) = delete;
+    Probes& operator=(const Probes&) = delete;
+
+    // Throws if any of the probes does not fit the grid
+    void Validate(const utils::Vec<int32_t, 3>& grid_size) const;
+
+    // get(field, i, j, k) returns the value of the field in the given cell
+    template<class Getter>
+    void Sample(uint64_t step, Getter&& get)
+    {
+        for (auto& probe : this->probes) {
+            if (step % probe.spec.every != 0) {
+                continue;
+            }
+            if (probe.current == nullptr) {
+                probe.current = AcquireBlock(probe);
+            }
+            auto& block = *probe.current;
+            // row layout here, transposed to columns by the writer
+            double* row = &block.values[static_cast<size_t>(block.count) * probe.points];
+            auto& from = probe.spec.from;
+            auto& to = probe.spec.to;
+            for (int32_t i = from[0]; i <= to[0]; i++) {
+                for (int32_t j = from[1]; j <= to[1]; j++) {
+                    for (int32_t k = from[2]; k <= to[2]; k++) {
+                        *row++ = get(probe.spec.field, i, j, k);
+                    }
+                }
+            }
+            block.steps[block.count++] = step;
+            if (block.count == this->samples_per_block) {
+                SubmitBlock(probe);
+            }
+        }
+    }
+
+    // Hands the partially filled blocks over to the writer
+    void Flush();
+
+private:
+    struct Block {
+        std::vector<uint64_t> steps;
+        std::vector<double> values;
+        uint32_t count = 0;
+    };
+
+    struct Probe {
+        ProbeSpec spec;
+        uint32_t index;
+        uint32_t points;
+        std::vector<Block> blocks; // preallocated, never resized
+        std::vector<Block*> free;  // guarded by mutex
+        Block* current = nullptr;
+    };
+
+    struct Job {
+        Probe* probe;
+        Block* block;
+    };
+
+    std::ofstream m_File;
+    std::vector<Probe> probes;
+    uint32_t samples_per_block;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> queue;
+    bool exit_requested = false;
+
+    Block* AcquireBlock(Probe& probe);
+    void SubmitBlock(Probe& probe);
+    void SaveHeader();
+    void WriterLoop();
+};
+
+}
@@ -0,0 +1,109 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <filesystem>
+
+#include "simulations/probes.hpp"
+#include "log.hpp"
+
+using namespace Simulation;
+
+double value(Field field, int32_t i, int32_t j, int32_t k, uint64_t step)
+{
+    return static_cast<double>(field) * 1e6 + step * 1000.0 + i * 100.0 + j * 10.0 + k;
+}
+
+template<class T>
+T read(std::ifstream& file)
+{
+    T value;
+    file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+int main(void)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "probes_test.probe").string();
+    const utils::Vec<int32_t, 3> grid{10, 10, 10};
+    constexpr uint64_t steps = 10;
+
+    // a point every step and a line every other step, blocks of 3 samples
+    {
+        Probes probes(filename, {
+            {"point", Field::EZ, {5, 5, 5}, {5, 5, 5}},
+            {"line", Field::HX, {1, 2, 3}, {1, 2, 6}, 2},
+        }, 3);
+        probes.Validate(grid);
+        for (uint64_t step = 0; step < steps; step++) {
+            probes.Sample(step, [step](Field field, int32_t i, int32_t j, int32_t k) {
+                return value(field, i, j, k, step);
+            });
+        }
+    }
+
+    std::ifstream file(filename, std::ios::binary);
+    char magic[8];
+    file.read(magic, sizeof(magic));
+    assert(std::memcmp(magic, "G3LPROBE", 8) == 0);
+    assert(read<uint32_t>(file) == Probes::VERSION);
+    assert(read<uint32_t>(file) == 2);
+    const uint32_t expected_points[2] = {1, 4};
+    for (uint32_t p = 0; p < 2; p++) {
+        auto length = read<uint32_t>(file);
+        file.seekg(length + sizeof(uint32_t) + 6 * sizeof(int32_t) + sizeof(uint32_t), std::ios::cur);
+        assert(read<uint32_t>(file) == expected_points[p]);
+    }
+
+    // blocks in columns, every sample where it belongs
+    uint64_t samples[2] = {0, 0};
+    while (true) {
+        auto index = read<uint32_t>(file);
+        if (!file) {
+            break;
+        }
+        auto count = read<uint32_t>(file);
+        assert(index < 2 && count > 0 && count <= 3);
+        std::vector<uint64_t> step(count);
+        file.read(reinterpret_cast<char*>(step.data()), sizeof(uint64_t) * count);
+        for (uint32_t point = 0; point < expected_points[index]; point++) {
+            for (uint32_t s = 0; s < count; s++) {
+                double sample = read<double>(file);
+                double expected = index == 0 ? value(Field::EZ, 5, 5, 5, step[s])
+                                             : value(Field::HX, 1, 2, 3 + point, step[s]);
+                assert(sample == expected);
+                assert(index == 0 || step[s] % 2 == 0);
+            }
+        }
+        samples[index] += count;
+    }
+    Log::debug("samples: ", samples[0], " ", samples[1]);
+    assert(samples[0] == steps && samples[1] == steps / 2);
+
+    // boxes turned inside out or off the grid are rejected before anything is allocated
+    bool thrown = false;
+    try {
+        Probes probes(filename, {{"inverted", Field::EX, {5, 5, 5}, {5, 4, 5}}});
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        Probes probes(filename, {{"negative", Field::EX, {-1, 0, 0}, {0, 0, 0}}});
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+        Probes probes(filename, {{"outside", Field::EX, {0, 0, 0}, {0, 0, 10}}});
+        probes.Validate(grid);
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    std::filesystem::remove(filename);
+    return 0;
+}
@@ -2,12 +2,12 @@
 
 #include <memory>
 #include <iostream>
-#include <fstream>
 #include<typeinfo> // TODO delete
 
 #include "log.hpp"
 #include "utilities.hpp"
 #include "simulations/base.hpp"
+#include "simulations/sim_file.hpp"
 
 namespace Simulation {
 
@@ -15,25 +15,22 @@ namespace Simulation {
  * Can either directly run and save the simulation,
  * or may act as a passthrough to Window, saving
  * the simulation while it is being run and displayed
+ *
+ * The steps are written in the background (SimWriter). With
+ * Backpressure::DROP a simulation outrunning the disk loses steps
+ * of the recording instead of being slowed down.
  */
 class Recorder : public BaseSimulation
 {
 public:
-    Recorder(std::unique_ptr<Simulation::BaseSimulation> sim, std::string filename) :
-        m_Simulation(std::move(sim))
+    Recorder(std::unique_ptr<Simulation::BaseSimulation> sim, std::string filename,
+             Backpressure backpressure = Backpressure::BLOCK) :
+        m_Simulation(std::move(sim)),
+        m_Writer(filename, m_Simulation->GetGridSize())
     {
-        m_File = std::ofstream(filename);
-        if (!m_File.is_open()) {
-            Log::critical("Failed to open file", filename);
-            throw std::runtime_error("Failed to open file");
-        }
         Log::info("Recording to file ", filename);
-        SaveHeader();
-    }
-
-    ~Recorder()
-    {
-        m_File.close();
+        this->gridSize = m_Simulation->GetGridSize();
+        m_Writer.SetBackpressure(backpressure);
     }
 
     /*
@@ -46,8 +43,7 @@ public:
     void InitRandomState() override
     {
         m_Simulation->InitRandomState();
-        m_File.seekp(0);
-        SaveHeader();
+        m_Writer.Restart();
     }
 
     double Step(double dt) override {
@@ -56,7 +52,43 @@ public:
         return actual_dt;
     }
 
-    inline const std::vector<Voxel, utils::TrackingAllocator<Voxel>>& GetVoxels() const override
+    void TriggerSource() override
+    {
+        m_Simulation->TriggerSource();
+    }
+
+    void CyclePalette() override
+    {
+        m_Simulation->CyclePalette();
+    }
+
+    // SetSlices is deliberately not passed through: a simulation with
+    // slices only colours the planes shown, the recording needs them all
+
+    bool Finished() const override
+    {
+        return m_Simulation->Finished();
+    }
+
+    bool SaveCheckpoint(const std::string& filename) override
+    {
+        return m_Simulation->SaveCheckpoint(filename);
+    }
+
+    bool LoadCheckpoint(const std::string& filename) override
+    {
+        return m_Simulation->LoadCheckpoint(filename);
+    }
+
+    void LogStats() override
+    {
+        m_Simulation->LogStats();
+        auto stats = m_Writer.Stats();
+        Log::info("recording: ", stats.written, " steps written, ", stats.dropped, " dropped, queue ",
+                  stats.queued, "/", stats.capacity, " (peak ", stats.peak_queued, ")");
+    }
+
+    inline const VoxelBuffer& GetVoxels() override
     {
         return m_Simulation->GetVoxels();
     }
@@ -80,44 +112,50 @@ public:
      * Recording related functions
      */
 
-    void Simulate(uint64_t steps) {
-        
+    // Headless recording, stops early once the simulation is finished
+    void Simulate(uint64_t steps, double dt = 0.1) {
+        for (uint64_t i = 0; i < steps && !m_Simulation->Finished(); i++) {
+            Step(dt);
+        }
+        LogStats();
     }
 
 
 
 private:
     std::unique_ptr<Simulation::BaseSimulation> m_Simulation;
-    std::ofstream m_File;
+    SimWriter m_Writer;
+    // Last saved frame in the file order (row, col, stack), only the voxels
+    // changed since then get transposed into it
+    std::vector<utils::Color> m_Frame;
+    uint64_t m_FrameVersion = 0;
 
     void SaveStep(double dt)
     {
-        auto& voxels = this->GetVoxels();
-        m_File.write(reinterpret_cast<char*>(&dt), sizeof(dt));
+        const auto& voxels = this->GetVoxels();
         auto [ rows, cols, stacks ] = m_Simulation->GetGridSize().elements;
-        for (auto row = 0; row < rows; row++) {
-            for (auto col = 0; col < cols; col++) {
-                for (auto stack = 0; stack < stacks; stack++) {
-                    auto& voxel = voxels[IndexFromSimCoords(row, col, stack)];
-                    auto [R,G,B,A] = voxel.color.elements;
-                    m_File.write(reinterpret_cast<char*>(&R), 1);
-                    m_File.write(reinterpret_cast<char*>(&G), 1);
-                    m_File.write(reinterpret_cast<char*>(&B), 1);
-                    m_File.write(reinterpret_cast<char*>(&A), 1);
+        auto to_file_order = [&](size_t begin, size_t end) {
+            auto [ row, col, stack ] = voxels.Position(begin).elements;
+            for (size_t index = begin; index < end; index++) {
+                m_Frame[(static_cast<size_t>(row) * cols + col) * stacks + stack] = voxels.colors[index];
+                if (++col == cols) {
+                    col = 0;
+                    if (++row == rows) {
+                        row = 0;
+                        stack++;
+                    }
                 }
             }
+        };
+        if (m_Frame.size() != voxels.Count()) {
+            m_Frame.resize(voxels.Count());
+            to_file_order(0, voxels.Count());
+        } else {
+            voxels.ForEachChangedRange(m_FrameVersion, to_file_order);
         }
-    }
+        m_FrameVersion = voxels.version;
 
-    void SaveHeader()
-    {
-        auto [ rows, cols, stacks ] = m_Simulation->GetGridSize().elements;
-        m_File.write(reinterpret_cast<char*>(&rows), sizeof(rows));
-        m_File.write(reinterpret_cast<char*>(&cols), sizeof(cols));
-        m_File.write(reinterpret_cast<char*>(&stacks), sizeof(stacks));
-        this->gridSize.elements[0] = rows;
-        this->gridSize.elements[1] = cols;
-        this->gridSize.elements[2] = stacks;
+        m_Writer.Write(dt, m_Frame);
     }
 };
 
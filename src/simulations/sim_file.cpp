@@ -0,0 +1,672 @@
+#include <new>
+#include <limits>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "log.hpp"
+#include "simulations/sim_file.hpp"
+
+namespace Simulation {
+
+namespace {
+
+constexpr uint32_t LEGACY_MAX_SIZE = 4096;
+
+uint32_t Word(const utils::Color& color)
+{
+    uint32_t word;
+    std::memcpy(&word, color.elements.data(), sizeof(word));
+    return word;
+}
+
+void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool GetVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        uint8_t byte = *data++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef HAVE_ZSTD
+// fastest level, the delta coding already did most of the work
+constexpr int ZSTD_LEVEL = 1;
+
+bool CompressZstd(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+    // one context per worker thread instead of one per frame
+    thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    out.resize(ZSTD_compressBound(in.size()));
+    size_t size = ZSTD_compressCCtx(context.get(), out.data(), out.size(), in.data(), in.size(), ZSTD_LEVEL);
+    if (ZSTD_isError(size)) {
+        Log::error("zstd compression failed: ", ZSTD_getErrorName(size));
+        return false;
+    }
+    out.resize(size);
+    return true;
+}
+#endif
+
+// Undoes the codec of the payload, returns the run length coded bytes
+bool Decompress(Codec codec, const uint8_t* payload, size_t payload_size,
+                [[maybe_unused]] std::vector<uint8_t>& runs, size_t raw_size, const uint8_t*& data)
+{
+    if (codec == Codec::NONE) {
+        data = payload;
+        return payload_size == raw_size;
+    }
+#ifdef HAVE_ZSTD
+    if (codec == Codec::ZSTD) {
+        runs.resize(raw_size);
+        size_t size = ZSTD_decompress(runs.data(), runs.size(), payload, payload_size);
+        data = runs.data();
+        return !ZSTD_isError(size) && size == raw_size;
+    }
+#endif
+    Log::error("Frame compressed with unsupported codec ", static_cast<uint32_t>(codec),
+               " (zstd needs a build with HAVE_ZSTD)");
+    return false;
+}
+
+}
+
+Codec DefaultCodec()
+{
+#ifdef HAVE_ZSTD
+    return Codec::ZSTD;
+#else
+    return Codec::NONE;
+#endif
+}
+
+void EncodeDelta(const utils::Color* frame, const utils::Color* previous, size_t count, std::vector<uint8_t>& out)
+{
+    out.clear();
+    size_t i = 0;
+    while (i < count) {
+        size_t zeros = i;
+        while (zeros < count && Word(frame[zeros]) == Word(previous[zeros])) {
+            zeros++;
+        }
+        size_t literals = zeros;
+        while (literals < count && Word(frame[literals]) != Word(previous[literals])) {
+            literals++;
+        }
+        PutVarint(out, zeros - i);
+        PutVarint(out, literals - zeros);
+        size_t pos = out.size();
+        out.resize(pos + (literals - zeros) * sizeof(uint32_t));
+        for (size_t j = zeros; j < literals; j++, pos += sizeof(uint32_t)) {
+            uint32_t delta = Word(frame[j]) ^ Word(previous[j]);
+            std::memcpy(&out[pos], &delta, sizeof(delta));
+        }
+        i = literals;
+    }
+}
+
+bool ApplyDelta(const uint8_t* data, size_t size, utils::Color* frame, size_t count)
+{
+    const uint8_t* end = data + size;
+    size_t i = 0;
+    while (data < end) {
+        uint64_t zeros, literals;
+        if (!GetVarint(data, end, zeros) || !GetVarint(data, end, literals) ||
+            zeros > count - i || literals > count - i - zeros ||
+            literals > static_cast<size_t>(end - data) / sizeof(uint32_t)) {
+            return false;
+        }
+        i += zeros;
+        for (uint64_t j = 0; j < literals; j++, i++, data += sizeof(uint32_t)) {
+            uint32_t delta;
+            std::memcpy(&delta, data, sizeof(delta));
+            uint32_t word = Word(frame[i]) ^ delta;
+            std::memcpy(frame[i].elements.data(), &word, sizeof(word));
+        }
+    }
+    return true;
+}
+
+SimWriter::SimWriter(const std::string& filename, const utils::Vec<int32_t, 3>& size, Codec codec,
+                     size_t workers) :
+    filename(filename),
+    size(size),
+    codec(codec)
+{
+    if (DefaultCodec() == Codec::NONE && codec != Codec::NONE) {
+        Log::warning("Built without zstd, recording only delta coded");
+        this->codec = Codec::NONE;
+    }
+    this->file_buffer.resize(FILE_BUFFER);
+    WriteHeader();
+
+    auto [rows, cols, stacks] = size.elements;
+    size_t count = static_cast<size_t>(rows) * cols * stacks;
+    this->previous.assign(count, utils::Color{0, 0, 0, 0});
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+    // a spare job per worker, so Write can queue the next frame while they are busy
+    this->jobs.resize(2 * workers);
+    for (auto& job : this->jobs) {
+        job.frame.resize(count);
+        job.previous.resize(count);
+        this->free.push_back(&job);
+    }
+    for (size_t i = 0; i < workers; i++) {
+        this->workers.emplace_back(&SimWriter::WorkerLoop, this);
+    }
+}
+
+SimWriter::~SimWriter()
+{
+    Flush();
+    WriteIndex();
+    {
+        std::lock_guard lock(this->mutex);
+        this->exit_requested = true;
+    }
+    this->cv.notify_all();
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+    if (this->raw_bytes > 0) {
+        Log::info("Recorded to ", this->filename, ", ",
+                  static_cast<double>(this->packed_bytes) / (1024 * 1024), " MB (",
+                  100.0 * static_cast<double>(this->packed_bytes) / static_cast<double>(this->raw_bytes),
+                  "% of raw)");
+    }
+    if (this->dropped > 0) {
+        Log::warning("Dropped ", this->dropped, " of ", this->dropped + this->written,
+                     " steps, the recording couldn't keep up");
+    }
+    if (this->blocked > 0) {
+        Log::warning("Waited for the recording on ", this->blocked, " of ", this->written, " steps");
+    }
+}
+
+void SimWriter::WriteHeader()
+{
+    if (this->file.is_open()) {
+        this->file.close();
+    }
+    this->file.clear();
+    // before opening, afterwards it has no effect
+    this->file.rdbuf()->pubsetbuf(this->file_buffer.data(), static_cast<std::streamsize>(this->file_buffer.size()));
+    this->file.open(this->filename, std::ios::binary | std::ios::trunc);
+    if (!this->file.is_open()) {
+        Log::critical("Failed to open file ", this->filename);
+        throw std::runtime_error("Failed to open file");
+    }
+    SimHeader header;
+    std::copy(this->size.elements.begin(), this->size.elements.end(), header.grid);
+    this->file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+// Nothing is being written after Flush, the file is ours
+void SimWriter::WriteIndex()
+{
+    if (this->failed) {
+        return;
+    }
+    SimIndexFooter footer;
+    footer.offset = static_cast<uint64_t>(this->file.tellp());
+    footer.count = this->index.size();
+    this->file.write(reinterpret_cast<const char*>(this->index.data()), sizeof(SimIndexEntry) * this->index.size());
+    this->file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    this->file.flush();
+    if (this->file.fail()) {
+        Log::error("Failed to write the step index to ", this->filename);
+    }
+}
+
+void SimWriter::Write(double dt, const std::vector<utils::Color>& frame)
+{
+    Job* job;
+    {
+        std::unique_lock lock(this->mutex);
+        if (this->free.empty() && this->backpressure == Backpressure::DROP) {
+            // the next step queued is a delta to the last one queued, so it just takes over the time
+            if (this->dropped++ == 0) {
+                Log::warning("Recording can't keep up, dropping steps");
+            }
+            this->dropped_dt += dt;
+            return;
+        }
+        if (this->free.empty()) {
+            if (this->blocked++ == 0) {
+                Log::warning("Recording can't keep up, waiting");
+            }
+            this->cv.wait(lock, [this] { return !this->free.empty(); });
+        }
+        job = this->free.back();
+        this->free.pop_back();
+        this->peak_queued = std::max(this->peak_queued, this->jobs.size() - this->free.size());
+    }
+    job->sequence = this->submitted++;
+    job->dt = this->dropped_dt + dt;
+    this->dropped_dt = 0.0;
+    this->time += job->dt;
+    job->time = this->time;
+    std::copy(frame.begin(), frame.end(), job->frame.begin());
+    std::swap(job->previous, this->previous);
+    job->keyframe = (job->sequence - this->first) % KEYFRAME_INTERVAL == 0;
+    if (job->keyframe) {
+        std::fill(job->previous.begin(), job->previous.end(), utils::Color{0, 0, 0, 0});
+    }
+    std::copy(frame.begin(), frame.end(), this->previous.begin());
+    {
+        std::lock_guard lock(this->mutex);
+        this->queue.push_back(job);
+    }
+    this->cv.notify_all();
+}
+
+void SimWriter::Flush()
+{
+    std::unique_lock lock(this->mutex);
+    this->cv.wait(lock, [this] { return this->written == this->submitted; });
+    this->file.flush();
+}
+
+void SimWriter::Restart()
+{
+    Flush();
+    WriteHeader();
+    this->first = this->submitted;
+    this->time = 0.0;
+    this->dropped_dt = 0.0;
+    this->index.clear();
+    this->raw_bytes = 0;
+    this->packed_bytes = 0;
+}
+
+SimWriterStats SimWriter::Stats()
+{
+    std::lock_guard lock(this->mutex);
+    SimWriterStats stats;
+    stats.written = this->written;
+    stats.dropped = this->dropped;
+    stats.queued = this->jobs.size() - this->free.size();
+    stats.peak_queued = this->peak_queued;
+    stats.capacity = this->jobs.size();
+    return stats;
+}
+
+void SimWriter::Encode(Job& job)
+{
+    EncodeDelta(job.frame.data(), job.previous.data(), job.frame.size(), job.runs);
+#ifdef HAVE_ZSTD
+    if (this->codec == Codec::ZSTD && CompressZstd(job.runs, job.packed) && job.packed.size() < job.runs.size()) {
+        return;
+    }
+#endif
+    job.packed.clear();
+}
+
+void SimWriter::WorkerLoop()
+{
+    while (true) {
+        Job* job;
+        {
+            std::unique_lock lock(this->mutex);
+            this->cv.wait(lock, [this] { return this->exit_requested || !this->queue.empty(); });
+            if (this->queue.empty()) {
+                return;
+            }
+            job = this->queue.front();
+            this->queue.pop_front();
+        }
+
+        Encode(*job);
+        bool packed = !job->packed.empty();
+        const auto& payload = packed ? job->packed : job->runs;
+        SimFrameHeader header;
+        header.dt = job->dt;
+        header.codec = static_cast<uint32_t>(packed ? this->codec : Codec::NONE);
+        header.size = static_cast<uint32_t>(payload.size());
+        header.raw_size = static_cast<uint32_t>(job->runs.size());
+        header.flags = job->keyframe ? SimFrameHeader::KEYFRAME : 0;
+
+        // the file is only touched by the worker whose turn it is
+        std::unique_lock lock(this->mutex);
+        this->cv.wait(lock, [&] { return this->written == job->sequence; });
+        lock.unlock();
+        // keep draining the queue after an error, the simulation shouldn't block
+        if (!this->failed) {
+            this->index.push_back(SimIndexEntry{static_cast<uint64_t>(this->file.tellp()), job->time, header.flags});
+            this->file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            this->file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+            if (this->file.fail()) {
+                Log::error("Failed to write step ", job->sequence, " to ", this->filename);
+                this->failed = true;
+            }
+        }
+        lock.lock();
+        this->written++;
+        this->raw_bytes += job->frame.size() * sizeof(utils::Color);
+        this->packed_bytes += sizeof(header) + payload.size();
+        this->free.push_back(job);
+        lock.unlock();
+        this->cv.notify_all();
+    }
+}
+
+SimReader::SimReader(const std::string& filename)
+{
+    this->file = std::ifstream(filename, std::ios::binary);
+    if (!this->file.is_open()) {
+        Log::critical("Failed to open playback file ", filename);
+        throw std::runtime_error("Failed to open file");
+    }
+
+    SimHeader header;
+    this->file.read(reinterpret_cast<char*>(&header), sizeof(header.magic));
+    if (std::memcmp(header.magic, SimHeader{}.magic, sizeof(header.magic)) == 0) {
+        this->file.read(reinterpret_cast<char*>(&header) + sizeof(header.magic),
+                        sizeof(header) - sizeof(header.magic));
+        this->version = header.version;
+    } else {
+        // version 1, the magic was rows already
+        std::memcpy(&header.grid[0], header.magic, sizeof(header.grid[0]));
+        this->file.read(reinterpret_cast<char*>(&header.grid[1]), 2 * sizeof(header.grid[0]));
+        this->version = 1;
+    }
+    bool valid = !this->file.fail() && this->version <= SimHeader::VERSION;
+    // the header may be damaged or foreign, the voxels have to fit a frame buffer
+    uint64_t voxels = 1;
+    for (int axis = 0; axis < 3; axis++) {
+        valid = valid && header.grid[axis] > 0 &&
+                (this->version > 1 || static_cast<uint32_t>(header.grid[axis]) < LEGACY_MAX_SIZE) &&
+                voxels <= std::numeric_limits<size_t>::max() / sizeof(utils::Color) /
+                          static_cast<uint64_t>(header.grid[axis]);
+        voxels *= valid ? static_cast<uint64_t>(header.grid[axis]) : 1;
+        this->size[axis] = header.grid[axis];
+    }
+    // and the file has to hold at least one frame header (a whole raw frame in version 1)
+    std::streamoff first = this->file.tellg();
+    if (valid) {
+        this->file.seekg(0, std::ios::end);
+        auto file_size = static_cast<uint64_t>(this->file.tellg());
+        this->file.seekg(first);
+        uint64_t frame_size = this->version > 1 ? sizeof(SimFrameHeader)
+                                                : sizeof(double) + voxels * sizeof(utils::Color);
+        valid = !this->file.fail() && file_size - static_cast<uint64_t>(first) >= frame_size;
+    }
+    if (!valid) {
+        const char* msg = "Failed to read sim dimensions from file";
+        Log::critical(msg, " ", filename);
+        throw std::runtime_error(msg);
+    }
+    Log::info("Playback sim dimensions: ", this->size[0], " ", this->size[1], " ", this->size[2],
+              ", version ", this->version);
+    try {
+        this->frame.assign(static_cast<size_t>(voxels), utils::Color{0, 0, 0, 0});
+    } catch (const std::bad_alloc&) {
+        const char* msg = "Sim dimensions too large to play back";
+        Log::critical(msg, " ", filename);
+        throw std::runtime_error(msg);
+    }
+
+    this->view = this->frame.data();
+
+    if (this->version < 3 || !ReadIndex()) {
+        BuildIndex(first);
+    }
+    Log::info("Playback of ", this->index.size(), " steps");
+    if (Map(filename)) {
+        this->file.close();
+        Prefetch(0, PREFETCH_STEPS);
+    }
+}
+
+SimReader::~SimReader()
+{
+#ifndef _WIN32
+    if (this->mapped != nullptr) {
+        munmap(const_cast<uint8_t*>(this->mapped), this->mapped_size);
+    }
+#endif
+}
+
+bool SimReader::ReadIndex()
+{
+    SimIndexFooter footer;
+    this->file.seekg(0, std::ios::end);
+    auto file_size = static_cast<uint64_t>(this->file.tellg());
+    this->file.seekg(-static_cast<std::streamoff>(sizeof(footer)), std::ios::end);
+    this->file.read(reinterpret_cast<char*>(&footer), sizeof(footer));
+    // the index has to fill the file up to the footer, or the footer is damaged
+    // (compared by division, a huge count mustn't overflow)
+    uint64_t index_end = file_size >= sizeof(footer) ? file_size - sizeof(footer) : 0;
+    bool fits = footer.offset <= index_end &&
+                footer.count == (index_end - footer.offset) / sizeof(SimIndexEntry) &&
+                (index_end - footer.offset) % sizeof(SimIndexEntry) == 0;
+    if (!this->file.fail() && fits &&
+        std::memcmp(footer.magic, SimIndexFooter{}.magic, sizeof(footer.magic)) == 0) {
+        this->index.resize(footer.count);
+        this->file.seekg(static_cast<std::streamoff>(footer.offset));
+        this->file.read(reinterpret_cast<char*>(this->index.data()), sizeof(SimIndexEntry) * footer.count);
+        if (!this->file.fail()) {
+            this->frames_end = footer.offset;
+            return true;
+        }
+    }
+    Log::warning("No step index in the playback file (recording interrupted?), scanning the steps");
+    this->index.clear();
+    this->file.clear();
+    return false;
+}
+
+// Only the frame headers are read, the payloads are skipped
+void SimReader::BuildIndex(std::streamoff first)
+{
+    this->file.clear();
+    this->file.seekg(0, std::ios::end);
+    std::streamoff end = this->file.tellg();
+    this->file.seekg(first);
+
+    std::streamoff offset = first;
+    double time = 0.0;
+    while (true) {
+        SimFrameHeader header;
+        std::streamoff frame_size;
+        if (this->version == 1) {
+            // raw frames, every one of them is a keyframe
+            this->file.read(reinterpret_cast<char*>(&header.dt), sizeof(header.dt));
+            header.flags = SimFrameHeader::KEYFRAME;
+            frame_size = sizeof(header.dt) + sizeof(utils::Color) * this->frame.size();
+        } else {
+            this->file.read(reinterpret_cast<char*>(&header), sizeof(header));
+            frame_size = sizeof(header) + header.size;
+        }
+        // a step cut off at the end of an interrupted recording doesn't count
+        if (this->file.fail() || offset + frame_size > end) {
+            break;
+        }
+        time += header.dt;
+        this->index.push_back(SimIndexEntry{static_cast<uint64_t>(offset), time, header.flags});
+        offset += frame_size;
+        this->file.seekg(offset);
+    }
+    this->frames_end = static_cast<uint64_t>(offset);
+}
+
+bool SimReader::Map(const std::string& filename)
+{
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* address = MAP_FAILED;
+    // too big for the address space (32 bit builds) is read as a stream
+    if (fstat(fd, &info) == 0 && info.st_size > 0 &&
+        static_cast<uint64_t>(info.st_size) <= std::numeric_limits<size_t>::max()) {
+        address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping keeps the file open
+    close(fd);
+    if (address == MAP_FAILED) {
+        Log::warning("Failed to map the playback file, reading it instead");
+        return false;
+    }
+    this->mapped = static_cast<const uint8_t*>(address);
+    this->mapped_size = static_cast<size_t>(info.st_size);
+    // no MADV_SEQUENTIAL, it drops pages behind the reader that stepping back and
+    // scrubbing still need, Prefetch asks for the steps about to be decoded instead
+    return true;
+#else
+    (void)filename;
+    return false;
+#endif
+}
+
+// Points data at size bytes of the file, in the mapping or read into payload
+bool SimReader::Bytes(uint64_t offset, size_t size, const uint8_t*& data)
+{
+    if (this->mapped != nullptr) {
+        if (offset > this->mapped_size || size > this->mapped_size - offset) {
+            return false;
+        }
+        data = this->mapped + offset;
+        return true;
+    }
+    this->payload.resize(size);
+    this->file.clear();
+    this->file.seekg(static_cast<std::streamoff>(offset));
+    this->file.read(reinterpret_cast<char*>(this->payload.data()), static_cast<std::streamsize>(size));
+    data = this->payload.data();
+    return !this->file.fail();
+}
+
+// Asks the kernel to read steps first .. last - 1 in, before they are needed
+void SimReader::Prefetch(uint64_t first, uint64_t last)
+{
+#ifndef _WIN32
+    last = std::min<uint64_t>(last, this->index.size());
+    if (this->mapped == nullptr || first >= last) {
+        return;
+    }
+    static const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t begin = this->index[first].offset / page * page;
+    uint64_t end = std::min<uint64_t>(last < this->index.size() ? this->index[last].offset : this->frames_end,
+                                      this->mapped_size);
+    if (begin < end) {
+        madvise(const_cast<uint8_t*>(this->mapped) + begin, end - begin, MADV_WILLNEED);
+    }
+#else
+    (void)first;
+    (void)last;
+#endif
+}
+
+bool SimReader::Fail(const char* message)
+{
+    Log::info(message);
+    this->at_end = true;
+    return false;
+}
+
+bool SimReader::ReadFrame(double& dt)
+{
+    if (this->at_end) {
+        return false;
+    }
+    // the index follows the last step
+    if (this->next >= this->index.size()) {
+        return Fail("Nothing more to load");
+    }
+    uint64_t offset = this->index[this->next].offset;
+    const uint8_t* data = nullptr;
+    if (this->version == 1) {
+        size_t bytes = sizeof(utils::Color) * this->frame.size();
+        if (!Bytes(offset, sizeof(dt) + bytes, data)) {
+            return Fail("Nothing more to load (or some error)");
+        }
+        std::memcpy(&dt, data, sizeof(dt));
+        data += sizeof(dt);
+        if (this->mapped != nullptr) {
+            // raw frames are used right where they are
+            this->view = reinterpret_cast<const utils::Color*>(data);
+        } else {
+            std::memcpy(reinterpret_cast<uint8_t*>(this->frame.data()), data, bytes);
+            this->view = this->frame.data();
+        }
+    } else {
+        SimFrameHeader header;
+        if (!Bytes(offset, sizeof(header), data)) {
+            return Fail("Nothing more to load");
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (this->next == 0 || (header.flags & SimFrameHeader::KEYFRAME) != 0) {
+            std::fill(this->frame.begin(), this->frame.end(), utils::Color{0, 0, 0, 0});
+        }
+        const uint8_t* runs = nullptr;
+        if (!Bytes(offset + sizeof(header), header.size, data) ||
+            !Decompress(static_cast<Codec>(header.codec), data, header.size, this->runs, header.raw_size, runs) ||
+            !ApplyDelta(runs, header.raw_size, this->frame.data(), this->frame.size())) {
+            Log::error("Corrupted step in the playback file");
+            return Fail("Stopping playback");
+        }
+        dt = header.dt;
+        this->view = this->frame.data();
+    }
+    this->next++;
+    Prefetch(this->next, this->next + PREFETCH_STEPS);
+    return true;
+}
+
+bool SimReader::Seek(uint64_t step)
+{
+    if (step >= this->index.size()) {
+        return false;
+    }
+    if (this->next == step + 1 && !this->at_end) {
+        return true;
+    }
+    uint64_t keyframe = step;
+    while (keyframe > 0 && (this->index[keyframe].flags & SimFrameHeader::KEYFRAME) == 0) {
+        keyframe--;
+    }
+    // going on from the current frame is cheaper when it's between the keyframe and the step
+    uint64_t start = this->next > keyframe && this->next <= step && !this->at_end ? this->next : keyframe;
+    this->at_end = false;
+    this->next = start;
+    Prefetch(start, step + 1);
+    double dt;
+    while (this->next <= step) {
+        if (!ReadFrame(dt)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <condition_variable>
+
+#include "utilities.hpp"
+
+namespace Simulation {
+
+/**
+ * Recorded simulations (.sim), version 3:
+ *
+ *   SimHeader
+ *   for every step: SimFrameHeader, size bytes of payload
+ *   SimIndexEntry for every step, SimIndexFooter
+ *
+ * A frame holds the colours of all the voxels in the file order (row, col,
+ * stack). It is XORed with the previous frame (keyframes and the first
+ * one with zeros), which turns every unchanged voxel into a zero word, the
+ * result is run length coded (EncodeDelta) and then compressed with the
+ * codec of the frame, unless that doesn't make it any smaller.
+ *
+ * Every KEYFRAME_INTERVAL steps there is a keyframe, so a seek decodes at
+ * most that many frames. The index at the end has the offset of every step,
+ * it is only written when the recording is closed, without it (or in version
+ * 2 files, which are the same without keyframes and index) the reader scans
+ * the frame headers.
+ *
+ * Version 1 files have no magic, just rows, cols and stacks as uint32_t
+ * followed by the raw frames (double dt, rows * cols * stacks colours).
+ * They are still played back, recording always writes the latest version.
+ */
+struct SimHeader {
+    static constexpr uint32_t VERSION = 3;
+
+    char magic[4] = {'G', '3', 'D', 'S'};
+    uint32_t version = VERSION;
+    int32_t grid[3] = {0, 0, 0}; // rows, cols, stacks
+};
+
+enum class Codec : uint32_t {
+    NONE = 0, // only delta and run length coded
+    ZSTD = 1, // needs HAVE_ZSTD (and -lzstd) to write or read
+};
+
+struct SimFrameHeader {
+    static constexpr uint32_t KEYFRAME = 1; // delta to zeros instead of the previous frame
+
+    double dt = 0.0;
+    uint32_t codec = 0;    // Codec of the payload
+    uint32_t size = 0;     // payload bytes following the header
+    uint32_t raw_size = 0; // run length coded bytes, before the codec
+    uint32_t flags = 0;
+};
+
+struct SimIndexEntry {
+    uint64_t offset = 0; // of the SimFrameHeader
+    double time = 0.0;   // simulation time after the step
+    uint32_t flags = 0;  // of the SimFrameHeader
+    uint32_t reserved = 0;
+};
+
+struct SimIndexFooter {
+    uint64_t offset = 0; // of the first SimIndexEntry
+    uint64_t count = 0;
+    char magic[4] = {'G', '3', 'D', 'I'};
+    uint32_t version = SimHeader::VERSION;
+};
+
+// ZSTD when built with HAVE_ZSTD, NONE otherwise
+Codec DefaultCodec();
+
+// Run length coding of frame ^ previous, as pairs of varint counts (zero
+// words, literal words) each followed by the literal words
+void EncodeDelta(const utils::Color* frame, const utils::Color* previous, size_t count, std::vector<uint8_t>& out);
+// XORs the coded delta into frame (holding the previous one), false when malformed
+bool ApplyDelta(const uint8_t* data, size_t size, utils::Color* frame, size_t count);
+
+// What Write does when all the job buffers are taken
+enum class Backpressure {
+    BLOCK, // wait for a worker, the simulation slows down to the disk
+    DROP,  // skip the step, the next one written covers its time
+};
+
+struct SimWriterStats {
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    size_t queued = 0;      // steps taken by Write and not written yet
+    size_t peak_queued = 0;
+    size_t capacity = 0;    // job buffers
+};
+
+/**
+ * Writes a .sim file. Write() only takes the delta to the previous frame,
+ * the coding and compression run on a pool of worker threads, and the
+ * worker finishing a frame writes it once all the frames before it are
+ * written. Write waits (or drops the step) only when all the job buffers
+ * are taken. The file gets a large buffer, so the writes are big ones.
+ */
+class SimWriter
+{
+public:
+    static constexpr uint64_t KEYFRAME_INTERVAL = 32;
+    static constexpr size_t FILE_BUFFER = 1 << 20;
+
+    // workers == 0: half of the hardware threads
+    SimWriter(const std::string& filename, const utils::Vec<int32_t, 3>& size, Codec codec = DefaultCodec(),
+              size_t workers = 0);
+    ~SimWriter();
+
+    SimWriter(const SimWriter&) = delete;
+    SimWriter& operator=(const SimWriter&) = delete;
+
+    // frame in the file order, rows * cols * stacks colours
+    void Write(double dt, const std::vector<utils::Color>& frame);
+    // Waits until everything queued is written
+    void Flush();
+    // Flushes and starts the file over (e.g. after a reset)
+    void Restart();
+
+    void SetBackpressure(Backpressure backpressure) { this->backpressure = backpressure; }
+    SimWriterStats Stats();
+
+private:
+    struct Job {
+        uint64_t sequence = 0;
+        double dt = 0.0;
+        double time = 0.0;
+        bool keyframe = false;
+        std::vector<utils::Color> frame;
+        std::vector<utils::Color> previous;
+        std::vector<uint8_t> runs;
+        std::vector<uint8_t> packed;
+    };
+
+    std::string filename;
+    utils::Vec<int32_t, 3> size;
+    Codec codec;
+    Backpressure backpressure = Backpressure::BLOCK;
+    std::vector<char> file_buffer;
+    std::ofstream file;
+    std::vector<utils::Color> previous; // last frame queued by Write
+    uint64_t submitted = 0;
+    uint64_t first = 0;  // sequence of the first step in the file
+    double time = 0.0;
+    double dropped_dt = 0.0; // of the steps dropped since the last one queued
+    uint64_t raw_bytes = 0;    // guarded by mutex, like everything below
+    uint64_t packed_bytes = 0;
+    uint64_t dropped = 0;
+    uint64_t blocked = 0;  // steps Write waited for a free job
+    size_t peak_queued = 0;
+    bool failed = false;
+
+    std::vector<Job> jobs;  // preallocated, never resized
+    std::vector<Job*> free;
+    std::deque<Job*> queue;
+    uint64_t written = 0;   // frames in the file, the next one to write
+    std::vector<SimIndexEntry> index; // only touched by the worker writing
+    bool exit_requested = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::thread> workers;
+
+    void WriteHeader();
+    void WriteIndex();
+    void WorkerLoop();
+    void Encode(Job& job);
+};
+
+/**
+ * Reads .sim files of all versions, step by step or seeking to any step.
+ *
+ * Except on Windows the file is memory mapped, the frames are decoded right
+ * from the mapping and the raw frames of version 1 files aren't copied at
+ * all. The kernel is asked to read ahead the next PREFETCH_STEPS steps, and
+ * the steps from the keyframe on when seeking.
+ * Files that can't be mapped are read through a stream instead.
+ */
+class SimReader
+{
+public:
+    static constexpr uint64_t PREFETCH_STEPS = 4;
+
+    explicit SimReader(const std::string& filename);
+    ~SimReader();
+
+    SimReader(const SimReader&) = delete;
+    SimReader& operator=(const SimReader&) = delete;
+
+    const utils::Vec<int32_t, 3>& Size() const { return this->size; }
+    uint32_t Version() const { return this->version; }
+    // Next frame, false past the last one or on error
+    bool ReadFrame(double& dt);
+    // Decodes the step (from the keyframe before it), the next ReadFrame goes on after it
+    bool Seek(uint64_t step);
+    // Frame read last, in the file order, valid until the next read or seek
+    // (it may point into the mapping)
+    const utils::Color* Frame() const { return this->view; }
+    bool AtEnd() const { return this->at_end; }
+    bool Mapped() const { return this->mapped != nullptr; }
+
+    uint64_t Count() const { return this->index.size(); }
+    // Step the next ReadFrame reads
+    uint64_t Position() const { return this->next; }
+    // Simulation time after the step
+    double Time(uint64_t step) const { return this->index[step].time; }
+
+private:
+    std::ifstream file;
+    utils::Vec<int32_t, 3> size{0, 0, 0};
+    uint32_t version = 1;
+    bool at_end = false;
+    uint64_t next = 0;
+    std::vector<SimIndexEntry> index;
+    uint64_t frames_end = 0; // offset after the last step
+    std::vector<utils::Color> frame;
+    const utils::Color* view = nullptr;
+    const uint8_t* mapped = nullptr;
+    size_t mapped_size = 0;
+    std::vector<uint8_t> payload; // what was read without a mapping
+    std::vector<uint8_t> runs;
+
+    bool ReadIndex();
+    void BuildIndex(std::streamoff first);
+    bool Map(const std::string& filename);
+    bool Bytes(uint64_t offset, size_t size, const uint8_t*& data);
+    void Prefetch(uint64_t first, uint64_t last);
+    bool Fail(const char* message);
+};
+
+}
@@ -0,0 +1,235 @@
+#include <cmath>
+#include <random>
+#include <cstring>
+#include <cassert>
+#include <fstream>
+#include <stdexcept>
+#include <filesystem>
+
+#include "simulations/sim_file.hpp"
+#include "log.hpp"
+
+using namespace Simulation;
+
+const auto white = utils::Color{255, 255, 255, 200};
+const auto transparent = utils::Color{0, 0, 0, 0};
+
+bool same(const std::vector<utils::Color>& a, const std::vector<utils::Color>& b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(utils::Color)) == 0;
+}
+
+bool same(const utils::Color* a, const std::vector<utils::Color>& b)
+{
+    return std::memcmp(a, b.data(), b.size() * sizeof(utils::Color)) == 0;
+}
+
+// Life like frames, a few voxels flip every step
+std::vector<std::vector<utils::Color>> make_frames(size_t count, size_t steps)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> voxel(0, count - 1);
+    std::vector<std::vector<utils::Color>> frames(1, std::vector<utils::Color>(count, transparent));
+    for (size_t i = 0; i < count; i++) {
+        frames[0][i] = rng() % 2 ? white : transparent;
+    }
+    for (size_t step = 1; step < steps; step++) {
+        frames.push_back(frames.back());
+        for (int flip = 0; flip < 50; flip++) {
+            auto& color = frames.back()[voxel(rng)];
+            uint8_t red = static_cast<uint8_t>(step), none = 0, full = 255;
+            color = color[3] != 0 ? transparent : utils::Color{red, none, none, full};
+        }
+    }
+    return frames;
+}
+
+int main(void)
+{
+    const utils::Vec<int32_t, 3> size{20, 16, 12};
+    const size_t count = 20 * 16 * 12;
+    auto frames = make_frames(count, 100);
+    auto filename = (std::filesystem::temp_directory_path() / "sim_file_test.sim").string();
+
+    // delta coding round trip, unchanged voxels cost next to nothing
+    std::vector<uint8_t> runs;
+    std::vector<utils::Color> decoded = frames[0];
+    EncodeDelta(frames[1].data(), frames[0].data(), count, runs);
+    Log::debug("delta of 50 flips: ", runs.size(), " bytes");
+    assert(runs.size() < 50 * 8);
+    assert(ApplyDelta(runs.data(), runs.size(), decoded.data(), count));
+    assert(same(decoded, frames[1]));
+    EncodeDelta(frames[1].data(), frames[1].data(), count, runs);
+    assert(runs.size() < 8);
+
+    // malformed deltas are rejected instead of writing out of bounds
+    EncodeDelta(frames[1].data(), frames[0].data(), count, runs);
+    assert(!ApplyDelta(runs.data(), runs.size(), decoded.data(), count / 2));
+    assert(!ApplyDelta(runs.data(), runs.size() - 1, decoded.data(), count));
+
+    // frames come back in order whatever worker wrote them
+    {
+        SimWriter writer(filename, size, DefaultCodec(), 4);
+        for (size_t step = 0; step < frames.size(); step++) {
+            writer.Write(0.1 * static_cast<double>(step + 1), frames[step]);
+        }
+    }
+    assert(std::filesystem::file_size(filename) < frames.size() * count * sizeof(utils::Color) / 10);
+    {
+        SimReader reader(filename);
+        assert(reader.Version() == SimHeader::VERSION);
+#ifndef _WIN32
+        assert(reader.Mapped());
+#endif
+        assert(reader.Size().elements == size.elements);
+        double dt;
+        for (size_t step = 0; step < frames.size(); step++) {
+            assert(reader.ReadFrame(dt));
+            assert(dt == 0.1 * static_cast<double>(step + 1));
+            assert(same(reader.Frame(), frames[step]));
+        }
+        assert(!reader.ReadFrame(dt));
+        assert(reader.AtEnd());
+    }
+
+    // any step from the index, backwards and in random order
+    {
+        SimReader reader(filename);
+        assert(reader.Count() == frames.size());
+        for (size_t step = frames.size(); step-- > 0; ) {
+            assert(reader.Seek(step));
+            assert(same(reader.Frame(), frames[step]));
+            assert(std::abs(reader.Time(step) - 0.05 * static_cast<double>((step + 1) * (step + 2))) < 1e-9);
+        }
+        std::mt19937 rng(1);
+        for (int i = 0; i < 50; i++) {
+            size_t step = rng() % frames.size();
+            assert(reader.Seek(step) && same(reader.Frame(), frames[step]));
+        }
+        // reading goes on after the step sought
+        double dt;
+        assert(reader.Seek(40) && reader.ReadFrame(dt) && same(reader.Frame(), frames[41]));
+        assert(!reader.Seek(frames.size()));
+    }
+
+    // a damaged footer is not trusted, the steps are scanned instead
+    {
+        std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-static_cast<std::streamoff>(sizeof(SimIndexFooter)) + 8, std::ios::end);
+        uint64_t count = 1ull << 40;
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    {
+        SimReader reader(filename);
+        assert(reader.Count() == frames.size());
+        assert(reader.Seek(50) && same(reader.Frame(), frames[50]));
+    }
+
+    // interrupted recording, no index and the last step cut off
+    std::filesystem::resize_file(filename, std::filesystem::file_size(filename) -
+                                           sizeof(SimIndexFooter) - sizeof(SimIndexEntry) * frames.size() - 10);
+    {
+        SimReader reader(filename);
+        assert(reader.Count() == frames.size() - 1);
+        assert(reader.Seek(70) && same(reader.Frame(), frames[70]));
+        assert(reader.Seek(3) && same(reader.Frame(), frames[3]));
+    }
+
+    // dropping steps that don't fit the queue, whatever is written still decodes
+    // and the step after a gap carries the time of the dropped ones
+    uint64_t dropped;
+    {
+        SimWriter writer(filename, size, DefaultCodec(), 1);
+        writer.SetBackpressure(Backpressure::DROP);
+        for (size_t step = 0; step < frames.size(); step++) {
+            writer.Write(0.1, frames[step]);
+            assert(writer.Stats().queued <= writer.Stats().capacity);
+        }
+        writer.Flush();
+        auto stats = writer.Stats();
+        Log::debug("dropped ", stats.dropped, " steps, peak queue ", stats.peak_queued);
+        assert(stats.written + stats.dropped == frames.size());
+        assert(stats.queued == 0 && stats.peak_queued <= stats.capacity);
+        dropped = stats.dropped;
+    }
+    {
+        SimReader reader(filename);
+        assert(reader.Count() == frames.size() - dropped);
+        double dt;
+        for (uint64_t step = 0; step < reader.Count(); step++) {
+            assert(reader.ReadFrame(dt));
+            auto shown = static_cast<size_t>(std::lround(reader.Time(step) / 0.1)) - 1;
+            assert(same(reader.Frame(), frames[shown]));
+        }
+    }
+
+    // restart throws away what was recorded so far
+    {
+        SimWriter writer(filename, size, Codec::NONE, 2);
+        writer.Write(0.1, frames[5]);
+        writer.Write(0.1, frames[6]);
+        writer.Restart();
+        writer.Write(0.2, frames[7]);
+    }
+    {
+        SimReader reader(filename);
+        double dt;
+        assert(reader.ReadFrame(dt) && dt == 0.2 && same(reader.Frame(), frames[7]));
+        assert(!reader.ReadFrame(dt));
+    }
+
+    // version 1, raw frames after the grid size
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(size.elements.data()), sizeof(size.elements));
+        for (size_t step = 0; step < 3; step++) {
+            double dt = 0.5;
+            file.write(reinterpret_cast<const char*>(&dt), sizeof(dt));
+            file.write(reinterpret_cast<const char*>(frames[step].data()), count * sizeof(utils::Color));
+        }
+    }
+    {
+        SimReader reader(filename);
+        assert(reader.Version() == 1);
+        assert(reader.Size().elements == size.elements);
+        double dt;
+        for (size_t step = 0; step < 3; step++) {
+            assert(reader.ReadFrame(dt) && dt == 0.5 && same(reader.Frame(), frames[step]));
+        }
+        assert(!reader.ReadFrame(dt));
+        assert(reader.Seek(1) && same(reader.Frame(), frames[1]));
+    }
+
+    // a damaged or foreign header can't make the reader allocate whatever it says
+    auto rejected = [&filename](const SimHeader& header, size_t padding) {
+        {
+            std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+            if (header.version > 1) {
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            } else {
+                file.write(reinterpret_cast<const char*>(header.grid), sizeof(header.grid));
+            }
+            file.write(std::string(padding, '\0').data(), static_cast<std::streamsize>(padding));
+        }
+        try {
+            SimReader reader(filename);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    SimHeader oversized;
+    oversized.grid[0] = oversized.grid[1] = oversized.grid[2] = 1 << 30;
+    assert(rejected(oversized, sizeof(SimFrameHeader)));
+    SimHeader empty;
+    empty.grid[0] = empty.grid[1] = empty.grid[2] = 10;
+    assert(rejected(empty, sizeof(SimFrameHeader) - 1));
+    assert(!rejected(empty, sizeof(SimFrameHeader)));
+    SimHeader legacy;
+    legacy.version = 1;
+    legacy.grid[0] = legacy.grid[1] = legacy.grid[2] = 4000;
+    assert(rejected(legacy, 1000));
+
+    std::filesystem::remove(filename);
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <cassert>
+#include <algorithm>
+
+#include "simulations/fdtd.hpp"
+#include "log.hpp"
+
+using namespace Simulation;
+
+int main(void)
+{
+    constexpr int32_t rows = 24, cols = 20, stacks = 16;
+    constexpr size_t plane = static_cast<size_t>(rows) * cols;
+    FDTD_3D sim(rows, cols, stacks);
+    for (int step = 0; step < 30; step++) {
+        sim.Step(0.0);
+    }
+
+    // each visible voxel on the planes once, also where two or all three of them cross
+    Slices slices;
+    slices.enabled = true;
+    slices.index = {rows / 2, cols / 2, stacks / 2};
+    sim.SetSlices(slices);
+    const auto& voxels = sim.GetVoxels();
+    std::vector<uint32_t> visible(voxels.visible.begin(), voxels.visible.end());
+    std::sort(visible.begin(), visible.end());
+    assert(std::adjacent_find(visible.begin(), visible.end()) == visible.end());
+
+    size_t expected = 0, crossing = 0;
+    for (size_t index = 0; index < voxels.colors.size(); index++) {
+        auto row = static_cast<int32_t>(index % plane / cols);
+        auto col = static_cast<int32_t>(index % cols);
+        auto stack = static_cast<int32_t>(index / plane);
+        int on = (row == slices.index[0]) + (col == slices.index[1]) + (stack == slices.index[2]);
+        if (on > 0 && voxels.colors[index].elements[3] != 0) {
+            expected++;
+            crossing += on > 1;
+        }
+    }
+    Log::debug("visible on the planes: ", expected, ", where they cross: ", crossing);
+    assert(crossing > 0);
+    assert(visible.size() == expected);
+
+    return 0;
+}
@@ -21,6 +21,12 @@ GLenum GLEWAPIENTRY glewInit(void);
 
 namespace UI {
 
+namespace {
+
+const utils::Color BACKGROUND{0, 0, 50, 255};
+
+}
+
 void draw_cube(utils::SimCoords pos) {
     // TODO asi jsou spatne normaly - pruhledne to vykresluje spatne
 //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -121,6 +127,9 @@ Window::Window(int width, int height) :
 
 Window::~Window()
 {
+    StopSimulation();
+    this->slice_renderer.Release();
+    this->voxel_renderer.Release();
     SDL_DestroyRenderer(this->renderer);
     SDL_GL_DestroyContext(this->context);
     SDL_DestroyWindow(this->window);
@@ -163,6 +172,7 @@ int Window::Init()
     }
 
     Resize(this->size);
+    this->voxel_renderer.Init();
 
     this->renderer = SDL_CreateRenderer(window, NULL);
     if (this->renderer == nullptr) {
@@ -176,6 +186,16 @@ int Window::Init()
     return 0;
 }
 
+int Window::InitHeadless()
+{
+    if (!this->headless.Init(this->size[0], this->size[1])) {
+        return 1;
+    }
+    Resize(this->size);
+    this->voxel_renderer.Init();
+    return 0;
+}
+
 void Window::Resize(int width, int height)
 {
     Resize(utils::Vec<int,2>{width, height});
@@ -211,16 +231,76 @@ void Window::ProcessEvents()
                 } else if (kbd_event.key == 'w') {
                     this->camera.SetZoom(-1);
                 } else if (kbd_event.key == ' ') { // Spacebar to toggle pause
-                    this->simulation_paused = !this->simulation_paused;
-                    Log::info(this->simulation_paused ? "Simulation paused" : "Simulation resumed");
+                    RunOnSimulation([this]() {
+                        this->simulation_paused = !this->simulation_paused;
+                        Log::info(this->simulation_paused ? "Simulation paused" : "Simulation resumed");
+                    });
                 } else if (kbd_event.key == 'a') {
                     this->alpha_enabled = !this->alpha_enabled;
                 } else if (kbd_event.key == 'z') {
                     this->wireframe_enabled = !this->wireframe_enabled;
+                } else if (kbd_event.key == 'v') {
+                    this->volume_enabled = !this->volume_enabled;
+                    Log::info("Volume rendering ", this->volume_enabled ? "on" : "off");
+                    // the ray marcher needs the whole grid coloured, not just the planes
+                    if (this->volume_enabled && this->slices.enabled) {
+                        this->slices.enabled = false;
+                        UpdateSlices();
+                    }
+                } else if (kbd_event.key == 'o') {
+                    this->lod_enabled = !this->lod_enabled;
+                    Log::info("Level of detail ", this->lod_enabled ? "on" : "off");
+                } else if (kbd_event.key == 't') {
+                    RunOnSimulation([this]() {
+                        bool adaptive = this->scheduler.Stride() != 0;
+                        this->scheduler.SetStride(adaptive ? 0 : this->throughput_stride);
+                        if (adaptive) {
+                            Log::info("Adaptive steps per frame");
+                        } else {
+                            Log::info("Max throughput, one frame per ", this->throughput_stride, " steps");
+                        }
+                    });
+                } else if (kbd_event.key == 'b') {
+                    RunOnSimulation([this]() {
+                        if (this->sim->SetReverse(!this->playback_reverse)) {
+                            this->playback_reverse = !this->playback_reverse;
+                        }
+                    });
+                } else if (kbd_event.key == ',' || kbd_event.key == '.') {
+                    bool forward = kbd_event.key == '.';
+                    RunOnSimulation([this, forward]() {
+                        uint64_t step = this->sim->CurrentStep();
+                        if (forward || step > 0) {
+                            this->sim->SeekStep(forward ? step + 1 : step - 1);
+                        }
+                    });
                 } else if (kbd_event.key == 'u') {
-                    this->UpdateSimulation(true);
+                    RunOnSimulation([this]() { StepSimulation(); });
                 } else if (kbd_event.key == 'p') {
-                    this->sim->TriggerSource();
+                    RunOnSimulation([this]() { this->sim->TriggerSource(); });
+                } else if (kbd_event.key == 'c') {
+                    RunOnSimulation([this]() { this->sim->CyclePalette(); });
+                } else if (kbd_event.key == 'x') {
+                    this->slices.enabled = !this->slices.enabled;
+                    UpdateSlices();
+                } else if (kbd_event.key >= '1' && kbd_event.key <= '3') {
+                    // toggle the plane perpendicular to rows / cols / stacks
+                    this->slice_axis = kbd_event.key - '1';
+                    auto& index = this->slices.index[this->slice_axis];
+                    index = index < 0 ? this->frames.Front().size[this->slice_axis] / 2 : -1;
+                    this->slices.enabled = true;
+                    UpdateSlices();
+                } else if (kbd_event.key == '[' || kbd_event.key == ']') {
+                    auto& index = this->slices.index[this->slice_axis];
+                    if (index >= 0) {
+                        int32_t last = this->frames.Front().size[this->slice_axis] - 1;
+                        index = std::clamp(index + (kbd_event.key == ']' ? 1 : -1), 0, last);
+                        UpdateSlices();
+                    }
+                } else if (kbd_event.key == 'k') {
+                    RunOnSimulation([this]() { this->sim->SaveCheckpoint(CHECKPOINT_FILENAME); });
+                } else if (kbd_event.key == 'l') {
+                    RunOnSimulation([this]() { this->sim->LoadCheckpoint(CHECKPOINT_FILENAME); });
                 } else if (kbd_event.key == '`') {
                     PrintTimeStats();
                 } else {
@@ -237,6 +317,9 @@ void Window::ProcessEvents()
                 if (mouse_event.down == true) {
                     this->mouse_prev_pos = utils::Vec<int,2>{mouse_event.x, mouse_event.y};
                 }
+                if (mouse_event.button == SDL_BUTTON_RIGHT) {
+                    Scrub(mouse_event.x);
+                }
                 break;
             }
             case SDL_EVENT_MOUSE_WHEEL: {
@@ -252,6 +335,8 @@ void Window::ProcessEvents()
                     camera.SetRotation(diff);
                 } else if (mouse_event.state == SDL_BUTTON_MMASK) {
                     camera.SetPan(diff);   
+                } else if (mouse_event.state == SDL_BUTTON_RMASK) {
+                    Scrub(mouse_event.x);
                 }
                 //Log::debug("Mouse motion event: ", diff[0], ", ", diff[1]);
                 mouse_prev_pos = mouse_current_pos;
@@ -261,6 +346,25 @@ void Window::ProcessEvents()
     }
 }
 
+// Right mouse button, the playback jumps to the step at the same fraction
+// of the recording as the mouse is of the window width
+void Window::Scrub(float x)
+{
+    int width, height;
+    SDL_GetWindowSize(this->window, &width, &height);
+    double fraction = std::clamp(static_cast<double>(x) / std::max(width, 1), 0.0, 1.0);
+    // the simulation thread seeks to the newest position only, one seek queued at a time
+    if (this->scrub_target.exchange(fraction) < 0.0) {
+        RunOnSimulation([this]() {
+            double target = this->scrub_target.exchange(-1.0);
+            uint64_t count = this->sim->StepCount();
+            if (count > 0) {
+                this->sim->SeekStep(static_cast<uint64_t>(target * static_cast<double>(count - 1) + 0.5));
+            }
+        });
+    }
+}
+
 bool Window::ExitRequested()
 {
     return this->exit_requested;
@@ -282,28 +386,97 @@ auto [R,G,B,A] = c.elements;
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void Window::UpdateSimulation(bool force = false) {
-    // conversion factor between real and simulation time:
-    // t_conversion_factor = real_time / simulation_time;
-    
-    //this->sim->Step(0.1);
-    //return;
+void Window::SimulationLoop()
+{
+    std::vector<std::function<void()>> pending;
+    while (true) {
+        {
+            std::unique_lock lock(this->command_mutex);
+            this->command_added.wait(lock, [this]() {
+                return this->sim_stop || !this->commands.empty() || !this->simulation_paused;
+            });
+            if (this->sim_stop) {
+                break;
+            }
+            pending.swap(this->commands);
+        }
+        for (auto& command : pending) {
+            command();
+        }
+        if (!pending.empty()) {
+            // commands (reset, checkpoint, ...) might have changed the voxels
+            PublishFrame();
+            pending.clear();
+        }
 
-    constexpr double t_conversion_factor = 0.5;
+        if (!this->simulation_paused) {
+            // as many steps as fit a frame, only the last one is shown
+            this->steps_per_frame = this->scheduler.Steps(this->sim_time.Recent(),
+                                                          this->render_cost.load(std::memory_order_relaxed));
+            for (uint32_t step = 0; step < this->steps_per_frame; step++) {
+                StepSimulation();
+                if (this->sim->Finished()) {
+                    Log::info("Simulation finished, pausing");
+                    this->simulation_paused = true;
+                    break;
+                }
+            }
+            PublishFrame();
+        }
+    }
+}
 
-    double current_time = GetUptime();
-    static double next_update_time = current_time;
+void Window::StopSimulation()
+{
+    if (!this->sim_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard lock(this->command_mutex);
+        this->sim_stop = true;
+    }
+    this->command_added.notify_one();
+    this->sim_thread.join();
+}
 
-    if (force || current_time >= next_update_time) {
-        this->sim->Step(0.1);
-        next_update_time = current_time + this->sim->GetStepSize() * t_conversion_factor;
+// Runs the command on the simulation thread between two steps,
+// or right away when the simulation thread isn't running
+void Window::RunOnSimulation(std::function<void()> command)
+{
+    if (!this->sim_thread.joinable()) {
+        command();
+        return;
+    }
+    {
+        std::lock_guard lock(this->command_mutex);
+        this->commands.push_back(std::move(command));
     }
+    this->command_added.notify_one();
+}
+
+void Window::StepSimulation()
+{
+    this->sim_time.Start();
+    this->sim->Step(0.1);
+    this->sim_time.Stop();
 }
 
-void Window::Render(const std::vector<Voxel, utils::TrackingAllocator<Voxel>>& voxels) {
-    ClearWindow(utils::Color{0,0,50,255});
+void Window::PublishFrame()
+{
+    this->frames.Back().CopyChangedFrom(this->sim->GetVoxels());
+    this->frames.Publish();
+}
+
+void Window::Render(const VoxelBuffer& voxels) {
+    ClearWindow(BACKGROUND);
     glViewport(0, 0, this->size[0], this->size[1]);
 
+    if (this->volume_enabled) {
+        DrawVolume(voxels);
+        this->Flush();
+        return;
+    }
+
     camera.SetPerspectiveProjection();
     camera.TranslateRotateScene();
 
@@ -321,10 +494,18 @@ void Window::Render(const std::vector<Voxel, utils::TrackingAllocator<Voxel>>& v
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
 
-    for (auto& voxel : voxels) {
-        auto [R,G,B,A] = voxel.color.elements;
-        glColor4ub(R,G,B,A);
-        draw_cube(voxel.position);
+    if (this->slices.Any()) {
+        this->slice_renderer.Draw(voxels, this->slices);
+    } else if (this->voxel_renderer.Available() && this->lod_enabled) {
+        this->voxel_renderer.DrawLOD(voxels, static_cast<float>(this->camera.PixelAngle(this->size[1])));
+    } else if (this->voxel_renderer.Available() && !this->alpha_enabled) {
+        this->voxel_renderer.DrawMesh(voxels);
+    } else if (!this->voxel_renderer.Available() || !this->voxel_renderer.Draw(voxels)) {
+        for (auto index : voxels.visible) {
+            auto [R,G,B,A] = voxels.colors[index].elements;
+            glColor4ub(R,G,B,A);
+            draw_cube(voxels.Position(index));
+        }
     }
 
     if (this->alpha_enabled) {
@@ -336,6 +517,22 @@ void Window::Render(const std::vector<Voxel, utils::TrackingAllocator<Voxel>>& v
     this->Flush();
 }
 
+// Ray marched on the CPU, the image is just copied to the framebuffer
+void Window::DrawVolume(const VoxelBuffer& voxels)
+{
+    this->raymarcher.Render(voxels, this->camera.GetView(), this->size[0], this->size[1], BACKGROUND);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, this->size[0], 0, this->size[1], -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+    glRasterPos2i(0, 0);
+    glDrawPixels(this->size[0], this->size[1], GL_RGBA, GL_UNSIGNED_BYTE, this->raymarcher.Pixels().data());
+    glEnable(GL_DEPTH_TEST);
+}
+
 void Window::DrawAxis() {
     constexpr double length = 100.0;
     glBegin(GL_LINES);
@@ -353,6 +550,9 @@ void Window::DrawAxis() {
 
 void Window::Flush()
 {
+    if (this->headless.Active()) {
+        return;
+    }
     // Swap the buffers
     SDL_GL_SwapWindow(window);
     // for some reason calling SDL_RenderPresent causes the window to be blank on Windows
@@ -369,7 +569,14 @@ void Window::PrintTimeStats()
     Log::info("Stats:");
     Log::info("total: ", this->total_time);
     Log::info("render: ", this->render_time);
-    Log::info("sim: ", this->sim_time);
+    // sim_time belongs to the simulation thread
+    RunOnSimulation([this]() {
+        Log::info("sim: ", this->sim_time);
+        Log::info("steps per frame: ", this->steps_per_frame);
+        if (this->sim) {
+            this->sim->LogStats();
+        }
+    });
 }
 
 double Window::GetUptime()
@@ -379,36 +586,87 @@ double Window::GetUptime()
 
 void Window::Run()
 {
+    PublishFrame();
+    this->sim_thread = std::thread(&Window::SimulationLoop, this);
+
     while (!ExitRequested()) {
         this->total_time.Start();
         ProcessEvents();
         UpdateTime();
-        if (!this->simulation_paused) {
-            this->sim_time.Start();
-            UpdateSimulation(true);
-            this->sim_time.Stop();
+
+        this->frames.Update();
+        this->render_time.Start();
+        Render(this->frames.Front());
+        this->render_time.Stop();
+        this->total_time.Stop();
+        this->render_cost.store(this->total_time.Recent(), std::memory_order_relaxed);
+    }
+    StopSimulation();
+    this->PrintTimeStats();
+}
+
+void Window::RunHeadless(FrameWriter& writer, uint64_t max_frames)
+{
+    uint64_t frames = 0;
+    while (frames < max_frames) {
+        this->total_time.Start();
+        // no display to keep up with, every frame unless max throughput
+        for (uint32_t step = 0; step < std::max(this->scheduler.Stride(), 1u) && !this->sim->Finished(); step++) {
+            StepSimulation();
+        }
+        if (this->sim->Finished()) {
+            Log::info("Simulation finished");
+            break;
         }
 
-        const auto& voxels = this->sim->GetVoxels();
         this->render_time.Start();
-        Render(voxels);
+        Render(this->sim->GetVoxels());
+        glReadPixels(0, 0, writer.Width(), writer.Height(), GL_RGBA, GL_UNSIGNED_BYTE, writer.Acquire());
+        writer.Submit();
         this->render_time.Stop();
         this->total_time.Stop();
+        frames++;
     }
     this->PrintTimeStats();
 }
 
+void Window::SetThroughput(uint32_t every)
+{
+    if (every > 0) {
+        this->throughput_stride = every;
+    }
+    this->scheduler.SetStride(every);
+}
+
 void Window::SetSimulation(std::unique_ptr<Simulation::BaseSimulation> new_sim)
 {
   this->sim = std::move(new_sim);
   auto [rows,cols,stacks] = this->sim->GetGridSize().elements;
   auto distance = std::max({rows,cols,stacks});
   this->camera.LookAt(this->sim->GetCenter(), distance);
+  this->lod_enabled = static_cast<size_t>(rows) * cols * stacks >= LOD_THRESHOLD;
+  if (this->lod_enabled) {
+      Log::info("Large grid, drawing with level of detail ('O' to toggle)");
+  }
+}
+
+void Window::UpdateSlices()
+{
+    if (this->slices.enabled && !this->slices.Any()) {
+        this->slices.index[this->slice_axis] = this->frames.Front().size[this->slice_axis] / 2;
+    }
+    if (this->slices.enabled && this->volume_enabled) {
+        this->volume_enabled = false;
+        Log::info("Volume rendering off");
+    }
+    Log::info("Slices ", this->slices.enabled ? "on" : "off", ": row ", this->slices.index[0],
+              ", col ", this->slices.index[1], ", stack ", this->slices.index[2]);
+    RunOnSimulation([this, slices = this->slices]() { this->sim->SetSlices(slices); });
 }
 
 void Window::ResetSimulation() {
     Log::info("Resetting simulation and real time...");
-    this->sim->InitRandomState();
+    RunOnSimulation([this]() { this->sim->InitRandomState(); });
     this->real_time_elapsed = 0.0; // Reset real time
 }
 
@@ -416,9 +674,30 @@ void Camera::SetPerspectiveProjection()
 {
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluPerspective(45.0f, this->aspect, 0.1f, 1000.0f);
+    gluPerspective(FIELD_OF_VIEW, this->aspect, 0.1f, 1000.0f);
 }   
 
+double Camera::PixelAngle(int height) const
+{
+    return FIELD_OF_VIEW * M_PI / 180.0 / height;
+}
+
+VolumeRaymarcher::View Camera::GetView()
+{
+    using namespace utils;
+    auto eye_pos = CSVec<CoordinateSystem::CARTESIAN, double, 3>(pos) + offset;
+    auto look_at = lookAt + offset;
+    VolumeRaymarcher::View view;
+    for (int axis = 0; axis < 3; axis++) {
+        view.eye[axis] = static_cast<float>(eye_pos[axis]);
+        view.target[axis] = static_cast<float>(look_at[axis]);
+        view.up[axis] = static_cast<float>(up[axis]);
+    }
+    view.fov_y = static_cast<float>(FIELD_OF_VIEW * M_PI / 180.0);
+    view.aspect = static_cast<float>(this->aspect);
+    return view;
+}
+
 void Camera::TranslateRotateScene()
 {
     using namespace utils;
@@ -1,17 +1,26 @@
 #pragma once
 
+#include <mutex>
+#include <atomic>
 #include <memory>
+#include <thread>
+#include <functional>
+#include <condition_variable>
 
 #include <SDL3/SDL.h>
 
 #include "simulations/base.hpp"
+#include "renderer.hpp"
+#include "raymarcher.hpp"
+#include "headless.hpp"
+#include "frame_writer.hpp"
 #include "utilities.hpp"
 #include "voxel.hpp"
 
 namespace UI
 {
 
-// Helper functions for rendering, these should ideally be replaced with some shader
+// Helper functions for rendering, fallback when VoxelRenderer isn't supported
 void draw_cube(utils::SimCoords pos = {0,0,0});
 void enable_light();
 
@@ -29,6 +38,7 @@ public:
     ~Camera() = default;
 
     static constexpr double CAMERA_ZOOM_FACTOR = 1.0;
+    static constexpr double FIELD_OF_VIEW = 45.0; // vertical, degrees
 
     void SetPan(MousePos diff);
     void SetZoom(float scroll_diff);
@@ -37,6 +47,10 @@ public:
 
     void SetPerspectiveProjection();
     void TranslateRotateScene();
+    // Angle (radians) covered by one pixel of a viewport height pixels high
+    double PixelAngle(int height) const;
+    // The same camera for VolumeRaymarcher
+    VolumeRaymarcher::View GetView();
 
     double aspect;
     utils::CSVec<CS::CARTESIAN, double, 3> lookAt; // TODO a bit confusing, lookAt always has to be zero, we use offset instead
@@ -60,6 +74,12 @@ private:
 
 class Window {
     public:
+        static constexpr const char* CHECKPOINT_FILENAME = "checkpoint.chk";
+        // grids with at least this many voxels start with level of detail on
+        static constexpr size_t LOD_THRESHOLD = 128 * 128 * 128;
+        // steps per shown frame in max throughput mode, unless set by SetThroughput
+        static constexpr uint32_t THROUGHPUT_STRIDE = 10;
+
         // SDL and OpenGL attributes
         SDL_Renderer* renderer;
         SDL_Window* window;
@@ -69,7 +89,11 @@ class Window {
         utils::Vec<int, 2> size;
         utils::Vec<int, 2> mouse_prev_pos;
         Camera camera;
-        bool simulation_paused = false;
+        VoxelRenderer voxel_renderer;
+        SliceRenderer slice_renderer;
+        VolumeRaymarcher raymarcher;
+        HeadlessContext headless;
+        bool simulation_paused = false; // owned by the simulation thread while running
         double real_time_elapsed = 0.0; // Tracks time passed in the real world
 
         Window();
@@ -78,7 +102,14 @@ class Window {
 
         int Init();
         void Run();
+        // Offscreen rendering without a display (see HeadlessContext), instead of Init/Run.
+        // Steps the simulation and writes every frame (every Nth with SetThroughput)
+        // until it finishes or max_frames.
+        int InitHeadless();
+        void RunHeadless(FrameWriter& writer, uint64_t max_frames);
         void SetSimulation(std::unique_ptr<Simulation::BaseSimulation> new_sim);
+        // Max throughput: shows only every Nth step ('T' toggles), 0 for adaptive
+        void SetThroughput(uint32_t every);
         void Resize(int width, int height);
         void Resize(utils::Vec<int, 2> new_size);
         void ResetSimulation(); // Added declaration for SimulationReset
@@ -89,16 +120,44 @@ class Window {
         bool exit_requested = false;
         bool wireframe_enabled = false;
         bool alpha_enabled = false;
+        bool lod_enabled = false;
+        bool volume_enabled = false;
+        Simulation::Slices slices;  // slice view, the simulation gets a copy
+        int slice_axis = 2;         // plane moved by the keys
         // time measurement
         utils::TimeStats render_time;
         utils::TimeStats sim_time;
         utils::TimeStats total_time;
+        // Steps per published frame, owned by the simulation thread while running.
+        // The render thread passes the recent cost of a frame along.
+        utils::StepScheduler scheduler;
+        uint32_t throughput_stride = THROUGHPUT_STRIDE;
+        uint32_t steps_per_frame = 1;
+        std::atomic<double> render_cost{0.0};
+        bool playback_reverse = false; // owned by the simulation thread
+        std::atomic<double> scrub_target{-1.0}; // fraction of the recording, -1 when no seek is queued
+        // The simulation runs on its own thread and publishes snapshots of
+        // its voxels, rendering always draws the newest complete one.
+        // Everything else touching sim goes through RunOnSimulation.
+        std::thread sim_thread;
+        std::mutex command_mutex;
+        std::condition_variable command_added;
+        std::vector<std::function<void()>> commands;
+        bool sim_stop = false; // guarded by command_mutex
+        utils::TripleBuffer<VoxelBuffer> frames;
 
         void ProcessEvents();
         bool ExitRequested();
         void ClearWindow(utils::Color c);
-        void UpdateSimulation(bool force);
-        void Render(const std::vector<Voxel, utils::TrackingAllocator<Voxel>>& voxels);
+        void SimulationLoop();
+        void StopSimulation();
+        void RunOnSimulation(std::function<void()> command);
+        void StepSimulation();
+        void PublishFrame();
+        void UpdateSlices();
+        void Scrub(float x);
+        void Render(const VoxelBuffer& voxels);
+        void DrawVolume(const VoxelBuffer& voxels);
         void DrawAxis();
         void Flush();
         void Resize();
@@ -1,12 +1,19 @@
 #pragma once
 
 #include <array>
+#include <algorithm>
 #include <cmath>
 #include <chrono>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <ranges>
+#include <thread>
+#include <vector>
 #include <cassert>
 #include <cstdint>
 #include <iostream>
+#include <condition_variable>
 
 #ifdef _WIN32
   #include <numbers>
@@ -59,6 +66,135 @@ constexpr int len(T (&array)[N])
     return N;
 }
 
+// Worker threads shared by all ParallelFor calls, started on first use and
+// kept for the whole run (ParallelFor runs per frame, starting threads for
+// every call would cost about as much as the work). Several threads may
+// hand work to it at the same time; the calling thread always works on its
+// own task too, so nested calls can't deadlock.
+class ThreadPool
+{
+  public:
+    static ThreadPool& Get()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(this->mutex);
+            this->exit_requested = true;
+        }
+        this->cv.notify_all();
+        for (auto& worker : this->workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // threads working on a task, the caller included
+    size_t Size(void) const { return this->workers.size() + 1; }
+
+    template<class Fn>
+    void Run(size_t count, Fn& fn)
+    {
+        Task task;
+        task.call = [](void* fn, size_t i) { (*static_cast<Fn*>(fn))(i); };
+        task.fn = &fn;
+        task.count = count;
+        {
+            std::lock_guard lock(this->mutex);
+            this->tasks.push_back(&task);
+        }
+        this->cv.notify_all();
+        Work(task);
+
+        std::unique_lock lock(this->mutex);
+        Finish(task);
+        this->done.wait(lock, [&] { return task.helpers == 0; });
+    }
+
+  private:
+    struct Task {
+        void (*call)(void* fn, size_t i) = nullptr;
+        void* fn = nullptr;
+        size_t count = 0;
+        std::atomic<size_t> next{0};
+        size_t helpers = 0; // workers on the task, guarded by mutex
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Task*> tasks; // with items left to hand out
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable done;
+    bool exit_requested = false;
+
+    ThreadPool()
+    {
+        size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t t = 1; t < n_threads; t++) {
+            this->workers.emplace_back(&ThreadPool::WorkerLoop, this);
+        }
+    }
+
+    static void Work(Task& task)
+    {
+        for (size_t i = task.next++; i < task.count; i = task.next++) {
+            task.call(task.fn, i);
+        }
+    }
+
+    // all items are handed out, nobody else needs to join
+    void Finish(Task& task)
+    {
+        auto it = std::find(this->tasks.begin(), this->tasks.end(), &task);
+        if (it != this->tasks.end()) {
+            this->tasks.erase(it);
+        }
+    }
+
+    void WorkerLoop()
+    {
+        std::unique_lock lock(this->mutex);
+        while (true) {
+            this->cv.wait(lock, [this] { return this->exit_requested || !this->tasks.empty(); });
+            if (this->exit_requested) {
+                return;
+            }
+            Task* task = this->tasks.front();
+            task->helpers++;
+            lock.unlock();
+            Work(*task);
+            lock.lock();
+            Finish(*task);
+            if (--task->helpers == 0) {
+                this->done.notify_all();
+            }
+        }
+    }
+};
+
+// Runs fn(i) for every i in [0, count) on all hardware threads (ThreadPool).
+// Items are handed out dynamically, so uneven work per item is fine,
+// but each item should be reasonably coarse (a row, a tile, ...).
+template<class Fn>
+void ParallelFor(size_t count, Fn&& fn)
+{
+    auto& pool = ThreadPool::Get();
+    if (pool.Size() <= 1 || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+    auto call = [&fn](size_t i) { fn(i); };
+    pool.Run(count, call);
+}
+
 /*
  * Classes
  */
@@ -393,6 +529,8 @@ class TimeStats
     double Max(void)  const { return this->max;  };
     double Mean(void) const { return this->mean; };
     double FPS(void) const  { return 1.0 / this->mean; };
+    // Exponential moving average, follows changes the overall mean hides
+    double Recent(void) const { return this->recent; };
 
     friend std::ostream& operator<<(std::ostream& os, const TimeStats& obj) {
         std::cout << "{ ";
@@ -410,7 +548,9 @@ class TimeStats
     double mean = 0.0;
     double min = std::numeric_limits<double>::max();
     double max = 0.0;
+    double recent = 0.0;
     std::chrono::time_point<clock> start;
+    static constexpr double RECENT_WEIGHT = 0.1;
 
     void Add(double value)
     {
@@ -423,10 +563,45 @@ class TimeStats
       auto& m = this->mean;
       
       m = (m * N + value) / (N+1);
+      this->recent = N == 0 ? value : this->recent + RECENT_WEIGHT * (value - this->recent);
       N++;
     }
 };
 
+// Number of simulation steps per displayed frame. Adaptive by default: as
+// many steps as fit one frame at the recent cost of a step, at least one.
+// Rendering runs on its own thread, so a frame lasts the budget or the
+// render cost, whichever is longer. With a stride every Nth step is shown
+// whatever the steps cost (max throughput), the others are only simulated.
+class StepScheduler
+{
+  public:
+    static constexpr uint32_t MAX_STEPS = 1000; // keeps commands between batches responsive
+
+    explicit StepScheduler(double budget = 1.0 / 60.0) : budget(budget) {}
+
+    void SetBudget(double seconds) { this->budget = seconds; }
+    void SetStride(uint32_t steps) { this->stride = steps; }  // 0 = adaptive
+    double Budget(void) const { return this->budget; }
+    uint32_t Stride(void) const { return this->stride; }
+
+    uint32_t Steps(double step_cost, double render_cost) const
+    {
+        if (this->stride > 0) {
+            return this->stride;
+        }
+        if (step_cost <= 0.0) {
+            return 1;
+        }
+        double frame = std::max(this->budget, render_cost);
+        return static_cast<uint32_t>(std::clamp(frame / step_cost, 1.0, static_cast<double>(MAX_STEPS)));
+    }
+
+  private:
+    double budget;
+    uint32_t stride = 0;
+};
+
 template <class T>
   class TrackingAllocator : public std::allocator<T>
   {
@@ -447,6 +622,46 @@ template <class T>
       size_t allocations = 0;
   };
 
+// Lock-free exchange of the latest value between one producer and one
+// consumer thread. The producer fills Back() and calls Publish(), the
+// consumer calls Update() and reads Front(). Neither side ever waits,
+// values the consumer did not pick up in time are skipped.
+template <class T>
+class TripleBuffer
+{
+  public:
+    // producer side
+    T& Back() { return this->slots[this->back]; }
+
+    void Publish()
+    {
+        auto old = this->middle.exchange(this->back | NEW, std::memory_order_acq_rel);
+        this->back = old & INDEX;
+    }
+
+    // consumer side, returns true when Front() changed
+    bool Update()
+    {
+        if (!(this->middle.load(std::memory_order_relaxed) & NEW)) {
+            return false;
+        }
+        auto old = this->middle.exchange(this->front, std::memory_order_acq_rel);
+        this->front = old & INDEX;
+        return true;
+    }
+
+    const T& Front() const { return this->slots[this->front]; }
+
+  private:
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t NEW = 0x4; // middle slot not seen by the consumer yet
+
+    std::array<T, 3> slots;
+    uint8_t back = 0;
+    uint8_t front = 1;
+    std::atomic<uint8_t> middle{2};
+};
+
 /*
  * Helper classes and utils
  */
@@ -32,6 +32,76 @@ void test_CSVec(
 
 int main(void)
 {
+    // TripleBuffer, consumer only ever sees complete values, in order
+    {
+        TripleBuffer<std::array<int, 64>> buffer;
+        constexpr int values = 100000;
+        std::thread producer([&]() {
+            for (int value = 1; value <= values; value++) {
+                buffer.Back().fill(value);
+                buffer.Publish();
+            }
+        });
+        int last = 0;
+        while (last < values) {
+            if (!buffer.Update()) {
+                continue;
+            }
+            const auto& front = buffer.Front();
+            assert(front[0] > last);
+            assert(std::all_of(front.begin(), front.end(), [&](int v) { return v == front[0]; }));
+            last = front[0];
+        }
+        producer.join();
+        assert(!buffer.Update());
+    }
+
+    // StepScheduler, as many steps as fit the frame, but at least one
+    {
+        StepScheduler scheduler(0.016);
+        assert(scheduler.Steps(0.0, 0.0) == 1);
+        assert(scheduler.Steps(0.001, 0.0) == 16);
+        assert(scheduler.Steps(0.001, 0.005) == 16);  // rendering is faster than the budget
+        assert(scheduler.Steps(0.001, 0.050) == 50);  // rendering takes longer
+        assert(scheduler.Steps(0.100, 0.005) == 1);
+        assert(scheduler.Steps(1e-9, 0.0) == StepScheduler::MAX_STEPS);
+        scheduler.SetStride(10);
+        assert(scheduler.Steps(0.001, 0.0) == 10);
+        assert(scheduler.Steps(0.100, 0.0) == 10);
+    }
+
+    // TimeStats, the recent mean follows a change in cost
+    {
+        TimeStats stats;
+        for (int i = 0; i < 100; i++) {
+            stats.Start();
+            std::this_thread::sleep_for(std::chrono::microseconds(i < 50 ? 100 : 2000));
+            stats.Stop();
+        }
+        assert(stats.Recent() > stats.Mean());
+        assert(stats.Recent() > 0.0015);
+    }
+
+    // ParallelFor, every item exactly once, also from several threads at once and nested
+    {
+        std::vector<std::atomic<int>> hits(1000);
+        auto count_hits = [&]() {
+            for (int round = 0; round < 50; round++) {
+                ParallelFor(hits.size(), [&](size_t i) { hits[i]++; });
+            }
+        };
+        std::thread other(count_hits);
+        count_hits();
+        other.join();
+        assert(std::all_of(hits.begin(), hits.end(), [](const std::atomic<int>& h) { return h == 100; }));
+
+        std::atomic<int> inner{0};
+        ParallelFor(8, [&](size_t) {
+            ParallelFor(8, [&](size_t) { inner++; });
+        });
+        assert(inner == 64);
+    }
+
     // Vec class
     Vec<int, 5> v1{1,2,3,4,5};
     Vec<int, 5> v2 = v1;
@@ -1,17 +1,157 @@
 #pragma once
 
+#include <vector>
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
 
 #include "utilities.hpp"
 
+static_assert(sizeof(utils::Color) == 4, "Color has to be tightly packed RGBA");
 
-struct Voxel {
-    // coordinates of the voxel are given by its position in Voxel array
-    utils::Color color;
-    utils::SimCoords position;
-    // TODO 
-    // create VBO (or something else) when creating Simulation,
-    // then during Updates only pass color array to the Window to draw them
-    Voxel() : color({0,0,0,0}), position({0,0,0}) {} 
+/**
+ * Colours of all the voxels of a simulation, one RGBA value per cell.
+ *
+ * Position of a voxel is given by its index in the buffer:
+ *     index = stack * (rows * cols) + row * cols + col
+ * (same as BaseSimulation::IndexFromSimCoords)
+ *
+ * Most of the voxels are usually fully transparent, so the simulations
+ * also keep a compacted list of the visible ones (alpha != 0) and only
+ * those get drawn.
+ *
+ * Changes are tracked per chunk of CHUNK consecutive voxels: every frame
+ * gets a new version and a chunk remembers the version in which one of
+ * its voxels last changed. Consumers (renderer, recorder) keep the
+ * version they have seen and only look at the chunks changed since.
+ *
+ * Either colour through BeginFrame() + SetColor(), or write the colors
+ * directly and call MarkAllChanged() afterwards.
+ */
+struct VoxelBuffer {
+    static constexpr uint32_t CHUNK = 1024;
 
+    utils::Vec<int32_t, 3> size; // rows, cols, stacks
+    std::vector<utils::Color, utils::TrackingAllocator<utils::Color>> colors;
+    std::vector<uint32_t> visible; // indices into colors
+    std::vector<uint64_t> chunk_version;
+    uint64_t version = 0;
+
+    void Resize(const utils::Vec<int32_t, 3>& new_size)
+    {
+        this->size = new_size;
+        auto [rows, cols, stacks] = new_size.elements;
+        this->colors.resize(static_cast<size_t>(rows) * cols * stacks);
+        this->chunk_version.resize((this->colors.size() + CHUNK - 1) / CHUNK);
+        // never reallocates while colouring
+        this->visible.reserve(this->colors.size());
+        MarkAllChanged();
+    }
+
+    void BeginFrame()
+    {
+        this->version++;
+        this->visible.clear();
+    }
+
+    void SetColor(uint32_t index, utils::Color color)
+    {
+        uint32_t old_packed, new_packed;
+        std::memcpy(&old_packed, &this->colors[index], sizeof(old_packed));
+        std::memcpy(&new_packed, &color, sizeof(new_packed));
+        if (old_packed != new_packed) {
+            this->colors[index] = color;
+            this->chunk_version[index / CHUNK] = this->version;
+        }
+        if (color[3] != 0) {
+            this->visible.push_back(index);
+        }
+    }
+
+    // Starts a new frame in which everything changed, rebuilds the visible list
+    void MarkAllChanged()
+    {
+        BeginFrame();
+        std::fill(this->chunk_version.begin(), this->chunk_version.end(), this->version);
+        for (uint32_t index = 0; index < this->colors.size(); index++) {
+            if (this->colors[index][3] != 0) {
+                this->visible.push_back(index);
+            }
+        }
+    }
+
+    // Calls fn(begin, end) for every run of voxels changed after version since
+    template <typename Fn>
+    void ForEachChangedRange(uint64_t since, Fn&& fn) const
+    {
+        size_t chunks = this->chunk_version.size();
+        for (size_t chunk = 0; chunk < chunks; ) {
+            if (this->chunk_version[chunk] <= since) {
+                chunk++;
+                continue;
+            }
+            size_t first = chunk;
+            while (chunk < chunks && this->chunk_version[chunk] > since) {
+                chunk++;
+            }
+            fn(first * CHUNK, std::min(chunk * CHUNK, Count()));
+        }
+    }
+
+    // Sets dirty[brick] for every brick of brick_size^3 voxels (numbered like
+    // the voxels, bricks per axis rounded up) with voxels changed after since
+    void MarkChangedBricks(uint64_t since, int32_t brick_size, std::vector<uint8_t>& dirty) const
+    {
+        auto [rows, cols, stacks] = this->size.elements;
+        int32_t brick_rows = (rows + brick_size - 1) / brick_size;
+        int32_t brick_cols = (cols + brick_size - 1) / brick_size;
+        size_t plane = static_cast<size_t>(rows) * cols;
+        ForEachChangedRange(since, [&](size_t begin, size_t end) {
+            // one step per piece of a row inside a brick
+            for (size_t index = begin; index < end; ) {
+                auto stack = static_cast<int32_t>(index / plane);
+                auto row = static_cast<int32_t>(index % plane / cols);
+                auto col = static_cast<int32_t>(index % cols);
+                size_t brick = static_cast<size_t>(stack / brick_size) * brick_rows * brick_cols +
+                               static_cast<size_t>(row / brick_size) * brick_cols + col / brick_size;
+                dirty[brick] = 1;
+                index += std::min(brick_size - col % brick_size, cols - col);
+            }
+        });
+    }
+
+    // Makes this a snapshot of other (versions included), copying only the
+    // chunks changed since this was last synchronized with it
+    void CopyChangedFrom(const VoxelBuffer& other)
+    {
+        if (this->Count() != other.Count() || this->version > other.version) {
+            *this = other;
+            return;
+        }
+        if (this->version == other.version) {
+            return;
+        }
+        this->size = other.size;
+        other.ForEachChangedRange(this->version, [&](size_t begin, size_t end) {
+            std::copy(other.colors.begin() + begin, other.colors.begin() + end,
+                      this->colors.begin() + begin);
+        });
+        this->visible.assign(other.visible.begin(), other.visible.end());
+        this->chunk_version = other.chunk_version;
+        this->version = other.version;
+    }
+
+    size_t Count() const { return this->colors.size(); }
+
+    // Raw RGBA bytes, 4 * Count() of them
+    const uint8_t* Data() const { return reinterpret_cast<const uint8_t*>(this->colors.data()); }
+    uint8_t* Data() { return reinterpret_cast<uint8_t*>(this->colors.data()); }
+
+    utils::SimCoords Position(size_t index) const
+    {
+        auto [rows, cols, stacks] = this->size.elements;
+        auto plane = static_cast<size_t>(rows) * cols;
+        auto in_plane = index % plane;
+        return utils::SimCoords{in_plane / cols, in_plane % cols, index / plane};
+    }
 };